@@ -0,0 +1,88 @@
+#include "arena.h"
+
+// where a block's data starts, rounded up so that it stays aligned
+#define ARENA_HEADER (((sizeof(ArenaBlock) + ARENA_ALIGN - 1) / ARENA_ALIGN) * ARENA_ALIGN)
+
+static char* blockData(ArenaBlock *block) {
+    return (char *)block + ARENA_HEADER;
+}
+
+Arena* createArena() {
+    Arena *arena = (Arena *)malloc(sizeof(Arena));
+    arena->current = NULL;
+    arena->spare = NULL;
+    return arena;
+}
+
+// Get a block with room for size bytes, a spare one if it is big enough
+static ArenaBlock* newBlock(Arena *arena, size_t size) {
+    ArenaBlock *block = arena->spare;
+    if (block != NULL && block->size >= size) {
+        arena->spare = block->next;
+    } else {
+        size_t dataSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = (ArenaBlock *)malloc(ARENA_HEADER + dataSize);
+        if (block == NULL) {
+            // this ends the process, and every compilation running in it
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        block->size = dataSize;
+    }
+    block->used = 0;
+    block->next = arena->current;
+    arena->current = block;
+    return block;
+}
+
+void* arenaAlloc(Arena *arena, size_t size) {
+    size = ((size + ARENA_ALIGN - 1) / ARENA_ALIGN) * ARENA_ALIGN;
+    ArenaBlock *block = arena->current;
+    if (block == NULL || block->size - block->used < size) {
+        block = newBlock(arena, size);
+    }
+    void *p = blockData(block) + block->used;
+    block->used += size;
+    return p;
+}
+
+char* arenaStrdup(Arena *arena, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = (char *)arenaAlloc(arena, len);
+    memcpy(copy, s, len);
+    return copy;
+}
+
+ArenaMark arenaMark(Arena *arena) {
+    ArenaMark mark;
+    mark.block = arena->current;
+    mark.used = arena->current ? arena->current->used : 0;
+    return mark;
+}
+
+// Drop everything allocated since mark was taken
+void arenaRelease(Arena *arena, ArenaMark mark) {
+    while (arena->current != mark.block) {
+        ArenaBlock *block = arena->current;
+        arena->current = block->next;
+        block->next = arena->spare;
+        arena->spare = block;
+    }
+    if (arena->current != NULL) {
+        arena->current->used = mark.used;
+    }
+}
+
+void deleteArena(Arena *arena) {
+    if (arena == NULL) return;
+    ArenaBlock *lists[2] = { arena->current, arena->spare };
+    for (int i = 0; i < 2; i++) {
+        ArenaBlock *block = lists[i];
+        while (block != NULL) {
+            ArenaBlock *next = block->next;
+            free(block);
+            block = next;
+        }
+    }
+    free(arena);
+}
@@ -0,0 +1,41 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGN 16
+
+// One chunk of arena memory; its data follows the header
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;   // the block filled before this one
+    size_t size;               // bytes of data
+    size_t used;
+} ArenaBlock;
+
+// Bump allocator for short-lived parser values.  Nothing is freed on its
+// own: everything allocated after a mark goes at once when the arena is
+// released back to that mark, and the rest when the arena is deleted.
+// Released blocks are kept and reused, so a compilation stops calling
+// malloc once it has seen its largest function.
+typedef struct Arena {
+    ArenaBlock *current;       // blocks in use, newest first
+    ArenaBlock *spare;         // released blocks waiting to be reused
+} Arena;
+
+// A point in an arena to release back to
+typedef struct ArenaMark {
+    ArenaBlock *block;
+    size_t used;
+} ArenaMark;
+
+Arena* createArena();
+void* arenaAlloc(Arena *arena, size_t size);
+char* arenaStrdup(Arena *arena, const char *s);
+ArenaMark arenaMark(Arena *arena);
+void arenaRelease(Arena *arena, ArenaMark mark);
+void deleteArena(Arena *arena);
+
+#endif
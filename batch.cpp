@@ -0,0 +1,135 @@
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static bool endsWith(const std::string &s, const std::string &suffix) {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::vector<std::string> collectSourceFiles(const std::vector<std::string> &args) {
+    std::vector<std::string> files;
+    for (const std::string &arg : args) {
+        struct stat st;
+        if (stat(arg.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            DIR *dir = opendir(arg.c_str());
+            if (!dir) {
+                perror(arg.c_str());
+                continue;
+            }
+            std::vector<std::string> found;
+            struct dirent *entry;
+            while ((entry = readdir(dir)) != NULL) {
+                std::string name = entry->d_name;
+                if (endsWith(name, ".sd")) {
+                    found.push_back(arg + "/" + name);
+                }
+            }
+            closedir(dir);
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        } else {
+            files.push_back(arg);
+        }
+    }
+    return files;
+}
+
+//-------------------------------------------------------------
+
+struct BatchJob {
+    std::string file;
+    FILE *output = NULL;    // everything its compilation reports
+    double ms = 0;
+    int status = 0;
+};
+
+// prints a finished job's output as one block
+static void reportJob(BatchJob &job) {
+    char buf[4096];
+    size_t n;
+    printf("==== %s ====\n", job.file.c_str());
+    rewind(job.output);
+    while ((n = fread(buf, 1, sizeof(buf), job.output)) > 0) {
+        fwrite(buf, 1, n, stdout);
+    }
+    fclose(job.output);
+    job.output = NULL;
+    fflush(stdout);
+}
+
+static void compileJob(BatchJob &job, const CompileOptions &options, CompileFunction compile,
+                       std::mutex &reporting) {
+    double start = nowMs();
+    job.output = tmpfile();
+    if (!job.output) {
+        std::lock_guard<std::mutex> lock(reporting);
+        perror("tmpfile");
+        job.status = 1;
+        return;
+    }
+    CompileOptions jobOptions = options;
+    jobOptions.diagnostics.stream = job.output;
+    job.status = compile(job.file.c_str(), jobOptions) == 0 ? 0 : 1;
+    job.ms = nowMs() - start;
+    std::lock_guard<std::mutex> lock(reporting);
+    reportJob(job);
+}
+
+int compileBatch(const std::vector<std::string> &files, int jobs,
+                 const CompileOptions &options, CompileFunction compile) {
+    if (jobs <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = (cores > 0) ? (int)cores : 1;
+    }
+    if ((size_t)jobs > files.size()) {
+        jobs = files.empty() ? 1 : (int)files.size();
+    }
+    std::vector<BatchJob> batch(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        batch[i].file = files[i];
+    }
+    std::atomic<size_t> next(0);
+    std::mutex reporting;   // one job's output at a time
+    double batchStart = nowMs();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < jobs; i++) {
+        workers.emplace_back([&]() {
+            for (size_t job = next++; job < batch.size(); job = next++) {
+                compileJob(batch[job], options, compile, reporting);
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    int failed = 0;
+    double totalMs = 0;
+    printf("==== batch summary: %zu files, %d jobs ====\n", batch.size(), jobs);
+    printf("%12s  %-6s  %s\n", "wall (ms)", "status", "file");
+    for (const BatchJob &job : batch) {
+        printf("%12.2f  %-6s  %s\n", job.ms, job.status == 0 ? "ok" : "FAILED", job.file.c_str());
+        totalMs += job.ms;
+        failed += job.status;
+    }
+    printf("%d failed; %.2f ms wall for the batch, %.2f ms summed over files\n",
+           failed, nowMs() - batchStart, totalMs);
+    return failed;
+}
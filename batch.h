@@ -0,0 +1,32 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "diagnostics.h"
+
+// How each file is compiled
+typedef struct CompileOptions {
+    bool listing;               // also write the class as javaa assembly
+    const char *listingPath;    // NULL for <name>.jasm, "-" for stdout
+    DiagnosticOptions diagnostics;
+} CompileOptions;
+
+// compiles one source file, returning 0 on success
+typedef int (*CompileFunction)(const char *input, const CompileOptions &options);
+
+// The .sd files named by args: files are taken as they are, directories
+// are searched (not recursively) for *.sd files, in name order.
+std::vector<std::string> collectSourceFiles(const std::vector<std::string> &args);
+
+// Compiles every file on a pool of jobs threads (0 for one per online
+// core), each taking the next file until none are left.  Every
+// compilation has a context of its own, and its messages go to a file of
+// its own (options.diagnostics.stream), which is printed in one piece when
+// it finishes, then a table of per-file wall times.  Returns the number
+// of files that failed.
+int compileBatch(const std::vector<std::string> &files, int jobs,
+                 const CompileOptions &options, CompileFunction compile);
+
+#endif
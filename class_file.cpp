@@ -0,0 +1,209 @@
+#include "class_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+
+#define CONSTANT_Utf8 1
+#define CONSTANT_Integer 3
+#define CONSTANT_Float 4
+#define CONSTANT_Double 6
+#define CONSTANT_Class 7
+#define CONSTANT_String 8
+#define CONSTANT_Fieldref 9
+#define CONSTANT_Methodref 10
+#define CONSTANT_NameAndType 12
+
+ClassFile::ClassFile(const std::string &name, Diagnostics *diag, const std::string &superName)
+    : className(name), diag(diag) {
+    thisClass = classConst(name);
+    superClass = classConst(superName);
+}
+
+// only the first limit is reported, as the rest tend to follow from it
+void ClassFile::error(const char *message) {
+    if (failed) return;
+    failed = true;
+    reportMessage(diag, DIAG_ERROR, 0, NULL, message);
+}
+
+//-------------------------------------------------------------
+
+// the bytes of an entry double as its key, so equal entries are only
+// stored once
+uint16_t ClassFile::addConst(const std::vector<uint8_t> &entry, int width) {
+    std::string key(entry.begin(), entry.end());
+    auto found = poolIndex.find(key);
+    if (found != poolIndex.end()) {
+        return found->second;
+    }
+    if (poolCount + width > CLASS_FILE_MAX_COUNT) {
+        error("Constant pool is full (the class file limit is 65535 entries)");
+        return 0;
+    }
+    uint16_t index = poolCount;
+    poolCount += width;
+    pool.insert(pool.end(), entry.begin(), entry.end());
+    poolIndex.emplace(key, index);
+    return index;
+}
+
+uint16_t ClassFile::utf8Const(const std::string &s) {
+    if (s.size() > CLASS_FILE_MAX_COUNT) {
+        error("String constant is longer than 65535 bytes");
+        return 0;
+    }
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_Utf8);
+    putU2(entry, s.size());
+    entry.insert(entry.end(), s.begin(), s.end());
+    return addConst(entry, 1);
+}
+
+uint16_t ClassFile::classConst(const std::string &name) {
+    uint16_t nameIndex = utf8Const(name);
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_Class);
+    putU2(entry, nameIndex);
+    return addConst(entry, 1);
+}
+
+uint16_t ClassFile::stringConst(const std::string &s) {
+    uint16_t utf8Index = utf8Const(s);
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_String);
+    putU2(entry, utf8Index);
+    return addConst(entry, 1);
+}
+
+uint16_t ClassFile::intConst(int32_t v) {
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_Integer);
+    putU4(entry, (uint32_t)v);
+    return addConst(entry, 1);
+}
+
+uint16_t ClassFile::floatConst(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_Float);
+    putU4(entry, bits);
+    return addConst(entry, 1);
+}
+
+uint16_t ClassFile::doubleConst(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_Double);
+    putU4(entry, (uint32_t)(bits >> 32));
+    putU4(entry, (uint32_t)bits);
+    return addConst(entry, 2);   // doubles take two pool indexes
+}
+
+uint16_t ClassFile::nameAndTypeConst(const std::string &name, const std::string &descriptor) {
+    uint16_t nameIndex = utf8Const(name);
+    uint16_t descriptorIndex = utf8Const(descriptor);
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_NameAndType);
+    putU2(entry, nameIndex);
+    putU2(entry, descriptorIndex);
+    return addConst(entry, 1);
+}
+
+uint16_t ClassFile::fieldConst(const std::string &owner, const std::string &name, const std::string &descriptor) {
+    uint16_t classIndex = classConst(owner);
+    uint16_t nameAndType = nameAndTypeConst(name, descriptor);
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_Fieldref);
+    putU2(entry, classIndex);
+    putU2(entry, nameAndType);
+    return addConst(entry, 1);
+}
+
+uint16_t ClassFile::methodConst(const std::string &owner, const std::string &name, const std::string &descriptor) {
+    uint16_t classIndex = classConst(owner);
+    uint16_t nameAndType = nameAndTypeConst(name, descriptor);
+    std::vector<uint8_t> entry;
+    putU1(entry, CONSTANT_Methodref);
+    putU2(entry, classIndex);
+    putU2(entry, nameAndType);
+    return addConst(entry, 1);
+}
+
+//-------------------------------------------------------------
+
+void ClassFile::addField(int access, const std::string &name, const std::string &descriptor, uint16_t constantValue) {
+    if (fieldCount >= CLASS_FILE_MAX_COUNT) {
+        error("Too many fields (the class file limit is 65535)");
+        return;
+    }
+    putU2(fields, access);
+    putU2(fields, utf8Const(name));
+    putU2(fields, utf8Const(descriptor));
+    if (constantValue != 0) {
+        putU2(fields, 1);   // attributes count
+        putU2(fields, utf8Const("ConstantValue"));
+        putU4(fields, 2);
+        putU2(fields, constantValue);
+    } else {
+        putU2(fields, 0);
+    }
+    fieldCount++;
+}
+
+void ClassFile::addMethod(int access, const std::string &name, const std::string &descriptor,
+                          const std::vector<uint8_t> &code, int maxStack, int maxLocals) {
+    if (methodCount >= CLASS_FILE_MAX_COUNT) {
+        error("Too many methods (the class file limit is 65535)");
+        return;
+    }
+    if (code.size() > CLASS_FILE_MAX_CODE) {
+        error("Method code is longer than 65535 bytes");
+        return;
+    }
+    putU2(methods, access);
+    putU2(methods, utf8Const(name));
+    putU2(methods, utf8Const(descriptor));
+    if (code.empty()) {
+        putU2(methods, 0);
+    } else {
+        putU2(methods, 1);   // attributes count
+        putU2(methods, utf8Const("Code"));
+        putU4(methods, 12 + code.size());
+        putU2(methods, maxStack);
+        putU2(methods, maxLocals);
+        putU4(methods, code.size());
+        methods.insert(methods.end(), code.begin(), code.end());
+        putU2(methods, 0);   // exception table length
+        putU2(methods, 0);   // attributes count
+    }
+    methodCount++;
+}
+
+//-------------------------------------------------------------
+
+bool ClassFile::write(const std::string &path) const {
+    std::vector<uint8_t> out;
+    out.reserve(24 + pool.size() + fields.size() + methods.size());
+    putU4(out, 0xCAFEBABE);
+    putU2(out, 0x0002);   // minor and major version, as javaa writes them
+    putU2(out, 0x002E);
+    putU2(out, poolCount);
+    out.insert(out.end(), pool.begin(), pool.end());
+    putU2(out, ACC_SUPER);
+    putU2(out, thisClass);
+    putU2(out, superClass);
+    putU2(out, 0);   // interfaces count
+    putU2(out, fieldCount);
+    out.insert(out.end(), fields.begin(), fields.end());
+    putU2(out, methodCount);
+    out.insert(out.end(), methods.begin(), methods.end());
+    putU2(out, 0);   // attributes count
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char *)out.data(), out.size());
+    file.close();
+    return !file.fail();
+}
@@ -0,0 +1,91 @@
+#ifndef CLASS_FILE_H
+#define CLASS_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "diagnostics.h"
+
+#define ACC_PUBLIC 0x0001
+#define ACC_STATIC 0x0008
+#define ACC_SUPER  0x0020
+
+// class file limits (counts and lengths are u2, code_length < 65536)
+#define CLASS_FILE_MAX_COUNT 65535
+#define CLASS_FILE_MAX_CODE 65535
+
+// big-endian writers for class file bytes and bytecode
+inline void putU1(std::vector<uint8_t> &out, int v) {
+    out.push_back((uint8_t)v);
+}
+
+inline void putU2(std::vector<uint8_t> &out, int v) {
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+inline void putU4(std::vector<uint8_t> &out, uint32_t v) {
+    out.push_back((uint8_t)(v >> 24));
+    out.push_back((uint8_t)(v >> 16));
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+// A class file built in memory.  Constant pool entries are added on
+// demand and shared, fields and methods are appended as they are declared,
+// and write() puts the whole file out at once.  Class names are in
+// internal form (java/lang/Object) and types are JVM descriptors (I,
+// [Ljava/lang/String;, (II)V).  Going past a class file limit is reported
+// as an error to diag, once; the class is then unfit to write, and the
+// compilation is expected to discard it.
+class ClassFile {
+public:
+    ClassFile(const std::string &name, Diagnostics *diag,
+              const std::string &superName = "java/lang/Object");
+
+    // constant pool entries; each returns the index of the (possibly
+    // existing) entry
+    uint16_t utf8Const(const std::string &s);
+    uint16_t classConst(const std::string &name);
+    uint16_t stringConst(const std::string &s);
+    uint16_t intConst(int32_t v);
+    uint16_t floatConst(float v);
+    uint16_t doubleConst(double v);
+    uint16_t nameAndTypeConst(const std::string &name, const std::string &descriptor);
+    uint16_t fieldConst(const std::string &owner, const std::string &name, const std::string &descriptor);
+    uint16_t methodConst(const std::string &owner, const std::string &name, const std::string &descriptor);
+
+    // constantValue is a constant pool index, 0 for none
+    void addField(int access, const std::string &name, const std::string &descriptor, uint16_t constantValue = 0);
+
+    // code is the method's bytecode; a method without code gets no Code
+    // attribute
+    void addMethod(int access, const std::string &name, const std::string &descriptor,
+                   const std::vector<uint8_t> &code, int maxStack, int maxLocals);
+
+    const std::string &name() const { return className; }
+    bool write(const std::string &path) const;
+
+private:
+    std::string className;
+    Diagnostics *diag;
+    bool failed = false;            // a limit has been reported
+    uint16_t thisClass;
+    uint16_t superClass;
+
+    std::vector<uint8_t> pool;      // entries as they appear in the file
+    int poolCount = 1;              // next index; entry 0 is unused
+    std::unordered_map<std::string, uint16_t> poolIndex;  // entry bytes -> index
+
+    std::vector<uint8_t> fields;
+    int fieldCount = 0;
+    std::vector<uint8_t> methods;
+    int methodCount = 0;
+
+    uint16_t addConst(const std::vector<uint8_t> &entry, int width);
+    void error(const char *message);
+};
+
+#endif
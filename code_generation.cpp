@@ -1,64 +1,701 @@
 #include "code_generation.h"
 #include <iostream>
+#include <stdio.h>
+#include <cmath>
+#include <stdlib.h>
+#include <algorithm>
 
-void CodeGenerator::emitTabs() {
-    for (int i = 0; i < tabCount; ++i) {
-        out << "    ";
+// java.lang.String -> java/lang/String
+static std::string internalName(const std::string &name) {
+    std::string result = name;
+    for (char &c : result) {
+        if (c == '.') c = '/';
+    }
+    return result;
+}
+
+// the JVM descriptor of a type as the listing spells it
+static std::string typeDescriptor(const std::string &type) {
+    std::string base = type;
+    std::string dims;
+    while (base.size() > 2 && base.compare(base.size() - 2, 2, "[]") == 0) {
+        dims += "[";
+        base.resize(base.size() - 2);
+    }
+    if (base == "int") return dims + "I";
+    if (base == "float") return dims + "F";
+    if (base == "double") return dims + "D";
+    if (base == "bool" || base == "boolean") return dims + "Z";
+    if (base == "byte") return dims + "B";
+    if (base == "short") return dims + "S";
+    if (base == "long") return dims + "J";
+    if (base == "void") return dims + "V";
+    if (base == "string" || base == "char") return dims + "Ljava/lang/String;";
+    return dims + "L" + internalName(base) + ";";
+}
+
+// A declared type as javaa spells it; string and bool are the source's
+// names for java.lang.String and boolean, and a char holds a string too
+static std::string javaaType(const std::string &type) {
+    if (type == "string" || type == "char") return "java.lang.String";
+    if (type == "bool") return "boolean";
+    return type;
+}
+
+// stack words a value of the given descriptor takes
+static int descriptorWords(const std::string &descriptor) {
+    if (descriptor == "V") return 0;
+    if (descriptor == "J" || descriptor == "D") return 2;
+    return 1;
+}
+
+// "(int, float)" style parameters and a return type to "(IF)V", with the
+// words the arguments take
+static std::string methodDescriptor(const std::string &returnType, const std::string &params,
+                                    int *argWords) {
+    std::string descriptor = "(";
+    *argWords = 0;
+    size_t start = 0;
+    while (start < params.size()) {
+        size_t end = params.find(',', start);
+        if (end == std::string::npos) end = params.size();
+        size_t first = params.find_first_not_of(' ', start);
+        size_t last = params.find_last_not_of(' ', end - 1);
+        if (first != std::string::npos && first < end) {
+            std::string param = typeDescriptor(params.substr(first, last - first + 1));
+            descriptor += param;
+            *argWords += descriptorWords(param);
+        }
+        start = end + 1;
+    }
+    return descriptor + ")" + typeDescriptor(returnType);
+}
+
+std::string realLiteral(float value) {
+    char digits[32];
+    snprintf(digits, sizeof(digits), "%.9g", value);
+    std::string text = digits;
+    if (text.find_first_of(".e") == std::string::npos) {
+        text += ".0";
+    }
+    return text;
+}
+
+bool OutputBuffer::open(const std::string &path) {
+    close();
+    file = (path == "-") ? stdout : fopen(path.c_str(), "w");
+    return file != NULL;
+}
+
+void OutputBuffer::flush() {
+    if (file == NULL) return;
+    if (!data.empty()) {
+        fwrite(data.data(), 1, data.size(), file);
+        data.clear();
     }
+    fflush(file);
 }
 
-CodeGenerator::CodeGenerator(const std::string &filename) {
-    out.open(filename + ".jasm");
+void OutputBuffer::close() {
+    if (file == NULL) return;
+    flush();
+    if (file != stdout) {
+        fclose(file);
+    }
+    file = NULL;
+}
+
+OutputBuffer &OutputBuffer::operator<<(int value) {
+    char digits[16];
+    int length = snprintf(digits, sizeof(digits), "%d", value);
+    data.append(digits, length);
+    return *this;
+}
+
+//-------------------------------------------------------------
+
+void CodeGenerator::emitTabs() {
+    out << indent;
+}
+
+void CodeGenerator::error(const std::string &message) {
+    reportMessage(diag, DIAG_ERROR, 0, NULL, message.c_str());
+}
+
+CodeGenerator::CodeGenerator(const std::string &filename, Diagnostics *diag, bool listing,
+                             const char *listingPath)
+    : className(filename), diag(diag), listing(listing) {
+    classFile = new ClassFile(internalName(filename), diag);
+    std::string path = listingPath ? listingPath : filename + ".jasm";
+    if (listing && !out.open(path)) {
+        error("couldn't write " + path);
+    }
+    writeClass = !(listing && path == "-");
     emitClassStart(filename);
 }
 
 CodeGenerator::~CodeGenerator() {
-    emitClassEnd();
-    if (out.is_open()) {
-        out.close();
+    // a discarded class streamed to javaa is left open, so that javaa
+    // rejects it rather than assembling what came before the error
+    if (!discarded || writeClass) {
+        emitClassEnd();
+    }
+    if (!discarded && writeClass && !classFile->write(className + ".class")) {
+        error("couldn't write " + className + ".class");
     }
+    delete classFile;
+    out.close();
 }
 
 //-------------------------------------------------------------
 
 void CodeGenerator::emitClassStart(const std::string &class_name) {
-    out << "class " << class_name << std::endl;
-    out << "{" << std::endl;
+    if (!listing) return;
+    out << "class " << class_name << '\n';
+    out << "{" << '\n';
     increaseTab();
 }
 
 void CodeGenerator::emitClassEnd() {
+    if (!listing) return;
     decreaseTab();
-    emitTabs(); out << "}" << std::endl;
+    emitTabs(); out << "}" << '\n';
+    out.flush();
 }
 
 //-------------------------------------------------------------
 
 void CodeGenerator::emitField(const std::string &name, const std::string &type, const std::string &value) {
+    std::string descriptor = typeDescriptor(type);
+    uint16_t constantValue = 0;
+    if (!value.empty()) {
+        if (descriptor == "F") {
+            constantValue = classFile->floatConst(std::stof(value));
+        } else if (descriptor == "D") {
+            constantValue = classFile->doubleConst(std::stod(value));
+        } else if (value[0] == '"') {
+            constantValue = classFile->stringConst(value.substr(1, value.size() - 2));
+        } else if (value == "true" || value == "false") {
+            constantValue = classFile->intConst(value == "true");
+        } else {
+            constantValue = classFile->intConst(std::stoi(value));
+        }
+    }
+    classFile->addField(ACC_STATIC, name, descriptor, constantValue);
+
+    if (!listing) return;
     emitTabs(); out << "field static " << type << " " << name;
     if (!value.empty()) {
-        out << " = " << value << std::endl;
+        // without the f javaa reads a double
+        out << " = " << value << (descriptor == "F" ? "f" : "") << '\n';
     } else {
-        out << std::endl;
+        out << '\n';
     }
 }
 
 void CodeGenerator::emitMethod(const std::string &name, const std::string &returnType, const std::string &params) {
-    emitTabs(); out << "method public static " << returnType << " " << name << "(" << params << ")" << std::endl;
-    emitTabs(); out << "max_stack 15" << std::endl;
-    emitTabs(); out << "max_locals 15" << std::endl;
+    int argWords;
+    std::string descriptor = methodDescriptor(returnType, params, &argWords);
+    emitMethod(name, returnType, params, descriptor, argWords);
+}
+
+void CodeGenerator::emitMethod(const std::string &name, const std::string &returnType, const std::string &params,
+                               const std::string &descriptor, int argWords) {
+    methodName = name;
+    methodType = descriptor;
+    inMethod = true;
+    code.clear();
+    labels.clear();
+    branches.clear();
+    stackDepth = 0;
+    maxStack = 0;
+    maxLocals = argWords;   // static, so no this
+    narrowedEnd = -1;
+
+    if (!listing) return;
+    emitTabs(); out << "method public static " << returnType << " " << name << "(" << params << ")" << '\n';
+    // javaa works out max_stack, and max_locals when it is left out, from
+    // the assembled code
+    emitTabs(); out << "max_stack auto" << '\n';
+}
+
+void CodeGenerator::emitField(const Name *name, const std::string &type, const std::string &value) {
+    Member &field = fields[name];
+    field.type = javaaType(type);
+    field.pushes = descriptorWords(typeDescriptor(type));
+    emitField(name->text, field.type, value);
+}
+
+void CodeGenerator::emitMethod(const Name *name, const std::string &returnType, const std::string &params) {
+    Member &method = methods[name];
+    method.type = returnType;
+    method.params = params;
+    method.descriptor = methodDescriptor(returnType, params, &method.pops);
+    method.pushes = descriptorWords(typeDescriptor(returnType));
+    emitMethod(name->text, returnType, params, method.descriptor, method.pops);
+}
+
+void CodeGenerator::emitMethod(const Function *function) {
+    Member &method = methods[function->name];
+    method.type = javaaType(function->type->text);
+    method.params.clear();
+    for (int i = 0; i < function->arity; i++) {
+        if (i > 0) method.params += ", ";
+        method.params += javaaType(function->paramTypes[i]->text);
+    }
+    method.descriptor = function->descriptor;
+    method.pops = function->argWords;
+    method.pushes = descriptorWords(typeDescriptor(method.type));
+    emitMethod(function->name->text, method.type, method.params, method.descriptor, method.pops);
 }
 
 void CodeGenerator::emitMethodStart() {
-    emitTabs(); out << "{" << std::endl;
+    if (!listing) return;
+    emitTabs(); out << "{" << '\n';
     increaseTab();
 }
 
 void CodeGenerator::emitMethodEnd() {
+    relaxBranches();
+    classFile->addMethod(ACC_PUBLIC | ACC_STATIC, methodName, methodType,
+                         code, maxStack, maxLocals);
+    inMethod = false;
+
+    if (!listing) return;
     decreaseTab();
-    emitTabs(); out << "}" << std::endl;
+    emitTabs(); out << "}" << '\n';
+    out.flush();
 }
 
 void CodeGenerator::emitReturn() {
-    emitTabs(); out << "return" << std::endl;
+    emitInstruction(OP_RETURN);
+}
+
+//-------------------------------------------------------------
+
+// keeps track of the stack depth as instructions are added, for max_stack
+void CodeGenerator::emitStack(int pops, int pushes) {
+    if (stackDepth < 0) {
+        stackDepth = 0;   // code nothing branches to
+    }
+    if (stackDepth < pops) {
+        error("stack underflow in " + methodName);
+        stackDepth = pops;
+    }
+    stackDepth += pushes - pops;
+    if (stackDepth > maxStack) {
+        maxStack = stackDepth;
+    }
+}
+
+void CodeGenerator::useLocal(int slot, int words) {
+    if (slot + words > maxLocals) {
+        maxLocals = slot + words;
+    }
+}
+
+void CodeGenerator::emitInstruction(JvmOpcode op) {
+    const JvmOpInfo &info = JvmOp(op);
+    if (info.operands != OPERANDS_NONE) {
+        error(std::string(info.mnemonic) + " needs an operand");
+        return;
+    }
+    if (op == OP_D2F) {
+        narrowedListing = out.size();
+    }
+    putU1(code, op);
+    narrowedEnd = (op == OP_D2F) ? (int)code.size() : -1;
+    emitStack(info.pops, info.pushes);
+    if (op >= OP_ILOAD_0 && op <= OP_ALOAD_3) {
+        useLocal((op - OP_ILOAD_0) % 4, info.pushes);
+    } else if (op >= OP_ISTORE_0 && op <= OP_ASTORE_3) {
+        useLocal((op - OP_ISTORE_0) % 4, info.pops);
+    } else if ((op >= OP_IRETURN && op <= OP_RETURN) || op == OP_ATHROW) {
+        stackDepth = -1;
+    }
+
+    if (!listingCode()) return;
+    emitTabs(); out << info.mnemonic << '\n';
+}
+
+bool CodeGenerator::undoNarrowing() {
+    if (narrowedEnd < 0 || narrowedEnd != (int)code.size()) return false;
+    code.pop_back();
+    stackDepth++;   // the double's second word
+    narrowedEnd = -1;
+    if (listingCode()) {
+        out.truncate(narrowedListing);
+    }
+    return true;
+}
+
+void CodeGenerator::emitInstruction(JvmOpcode op, int operand) {
+    const JvmOpInfo &info = JvmOp(op);
+    switch (info.operands) {
+    case OPERANDS_BYTE:
+        if (operand < -128 || operand > 127) {
+            error(std::to_string(operand) + " does not fit bipush");
+            return;
+        }
+        putU1(code, op);
+        putU1(code, operand);
+        break;
+    case OPERANDS_SHORT:
+        if (operand < -32768 || operand > 32767) {
+            error(std::to_string(operand) + " does not fit sipush");
+            return;
+        }
+        putU1(code, op);
+        putU2(code, operand);
+        break;
+    case OPERANDS_LOCAL:
+        if (operand < 0 || operand > 65535) {
+            error("local variable slot out of range");
+            return;
+        }
+        if (operand <= 3 && op >= OP_ILOAD && op <= OP_ALOAD) {
+            // iload 2 -> iload_2, as javaa assembles it
+            putU1(code, OP_ILOAD_0 + (op - OP_ILOAD) * 4 + operand);
+        } else if (operand <= 3 && op >= OP_ISTORE && op <= OP_ASTORE) {
+            putU1(code, OP_ISTORE_0 + (op - OP_ISTORE) * 4 + operand);
+        } else if (operand > 255) {
+            putU1(code, OP_WIDE);
+            putU1(code, op);
+            putU2(code, operand);
+        } else {
+            putU1(code, op);
+            putU1(code, operand);
+        }
+        // a load pushes, and a store pops, the words the slot holds
+        useLocal(operand, (info.pushes + info.pops > 0) ? info.pushes + info.pops : 1);
+        break;
+    case OPERANDS_NEWARRAY:
+        putU1(code, op);
+        putU1(code, operand);
+        break;
+    default:
+        error(std::string(info.mnemonic) + " does not take a number");
+        return;
+    }
+    emitStack(info.pops, info.pushes);
+    if (op == OP_RET) {
+        stackDepth = -1;
+    }
+
+    if (!listingCode()) return;
+    emitTabs(); out << info.mnemonic << " " << operand << '\n';
+}
+
+void CodeGenerator::emitIncrement(int slot, int amount) {
+    if (slot < 0 || slot > 65535 || amount < -32768 || amount > 32767) {
+        error("iinc out of range");
+        return;
+    }
+    if (slot > 255 || amount < -128 || amount > 127) {
+        putU1(code, OP_WIDE);
+        putU1(code, OP_IINC);
+        putU2(code, slot);
+        putU2(code, amount);
+    } else {
+        putU1(code, OP_IINC);
+        putU1(code, slot);
+        putU1(code, amount);
+    }
+    useLocal(slot, 1);
+
+    if (!listingCode()) return;
+    emitTabs(); out << "iinc " << slot << " " << amount << '\n';
+}
+
+void CodeGenerator::emitConstant(int value) {
+    if (value >= -1 && value <= 5) {
+        emitInstruction((JvmOpcode)(OP_ICONST_0 + value));
+    } else if (value >= -128 && value <= 127) {
+        emitInstruction(OP_BIPUSH, value);
+    } else if (value >= -32768 && value <= 32767) {
+        emitInstruction(OP_SIPUSH, value);
+    } else {
+        emitLoadConstant(value);
+    }
+}
+
+void CodeGenerator::emitConstant(float value) {
+    // javaa has no signed float literal, so a negative one (-0.0f too) is
+    // its magnitude negated
+    if (std::signbit(value)) {
+        emitConstant(-value);
+        emitInstruction(OP_FNEG);
+    } else if (value == 0.0f || value == 1.0f || value == 2.0f) {
+        emitInstruction((JvmOpcode)(OP_FCONST_0 + (int)value));
+    } else {
+        emitLoadConstant(value);
+    }
+}
+
+void CodeGenerator::emitConstant(const std::string &value) {
+    emitLoadConstant(value);
+}
+
+void CodeGenerator::emitConstantIndex(uint16_t index) {
+    if (index > 255) {
+        putU1(code, OP_LDC_W);
+        putU2(code, index);
+    } else {
+        putU1(code, OP_LDC);
+        putU1(code, index);
+    }
+    emitStack(0, 1);
+}
+
+void CodeGenerator::emitLoadConstant(int value) {
+    emitConstantIndex(classFile->intConst(value));
+
+    if (!listingCode()) return;
+    emitTabs(); out << "ldc " << value << '\n';
+}
+
+void CodeGenerator::emitLoadConstant(float value) {
+    emitConstantIndex(classFile->floatConst(value));
+
+    if (!listingCode()) return;
+    emitTabs(); out << "ldc " << realLiteral(value) << "f" << '\n';
+}
+
+void CodeGenerator::emitLoadConstant(const std::string &value) {
+    emitConstantIndex(classFile->stringConst(value));
+
+    if (!listingCode()) return;
+    emitTabs(); out << "ldc \"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (c == '\n') out << "\\n";
+        else out << c;
+    }
+    out << "\"" << '\n';
+}
+
+void CodeGenerator::emitFieldInstruction(JvmOpcode op, const std::string &type,
+                                         const std::string &owner, const std::string &name) {
+    std::string descriptor = typeDescriptor(type);
+    int words = descriptorWords(descriptor);
+    putU1(code, op);
+    putU2(code, classFile->fieldConst(internalName(owner), name, descriptor));
+    switch (op) {
+    case OP_GETSTATIC: emitStack(0, words); break;
+    case OP_PUTSTATIC: emitStack(words, 0); break;
+    case OP_GETFIELD:  emitStack(1, words); break;
+    case OP_PUTFIELD:  emitStack(1 + words, 0); break;
+    default:
+        error(std::string(JvmOp(op).mnemonic) + " is not a field instruction");
+    }
+
+    if (!listingCode()) return;
+    emitTabs(); out << JvmOp(op).mnemonic << " " << type << " " << owner << "." << name << '\n';
+}
+
+void CodeGenerator::emitMethodInstruction(JvmOpcode op, const std::string &returnType,
+                                          const std::string &owner, const std::string &name,
+                                          const std::string &params) {
+    int argWords;
+    std::string descriptor = methodDescriptor(returnType, params, &argWords);
+    if (op != OP_INVOKEVIRTUAL && op != OP_INVOKENONVIRTUAL && op != OP_INVOKESTATIC) {
+        error(std::string(JvmOp(op).mnemonic) + " is not supported here");
+        return;
+    }
+    putU1(code, op);
+    putU2(code, classFile->methodConst(internalName(owner), name, descriptor));
+    emitStack(argWords + (op == OP_INVOKESTATIC ? 0 : 1),
+              descriptorWords(typeDescriptor(returnType)));
+
+    if (!listingCode()) return;
+    emitTabs(); out << JvmOp(op).mnemonic << " " << returnType << " " << owner << "." << name
+                    << "(" << params << ")" << '\n';
+}
+
+void CodeGenerator::emitStaticField(JvmOpcode op, const Name *name) {
+    auto found = fields.find(name);
+    if (found == fields.end()) {
+        error(std::string("no field ") + name->text + " in " + className);
+        return;
+    }
+    Member &field = found->second;
+    if (field.ref == 0) {
+        field.ref = classFile->fieldConst(classFile->name(), name->text, typeDescriptor(field.type));
+    }
+    putU1(code, op);
+    putU2(code, field.ref);
+    switch (op) {
+    case OP_GETSTATIC: emitStack(0, field.pushes); break;
+    case OP_PUTSTATIC: emitStack(field.pushes, 0); break;
+    default:
+        error(std::string(JvmOp(op).mnemonic) + " is not a static field instruction");
+    }
+
+    if (!listingCode()) return;
+    emitTabs(); out << JvmOp(op).mnemonic << " " << field.type << " " << className << "." << name->text << '\n';
+}
+
+void CodeGenerator::emitInvokeStatic(const Name *name) {
+    auto found = methods.find(name);
+    if (found == methods.end()) {
+        error(std::string("no method ") + name->text + " in " + className);
+        return;
+    }
+    Member &method = found->second;
+    if (method.ref == 0) {
+        method.ref = classFile->methodConst(classFile->name(), name->text, method.descriptor);
+    }
+    putU1(code, OP_INVOKESTATIC);
+    putU2(code, method.ref);
+    emitStack(method.pops, method.pushes);
+
+    if (!listingCode()) return;
+    emitTabs(); out << "invokestatic " << method.type << " " << className << "." << name->text
+                    << "(" << method.params << ")" << '\n';
+}
+
+//-------------------------------------------------------------
+
+int CodeGenerator::newLabel() {
+    labels.push_back(Label());
+    return labels.size();
+}
+
+int CodeGenerator::joinLabels(int label, int other) {
+    if (label == 0) return other;
+    if (other == 0 || other == label) return label;
+    int last = label;
+    while (labels[last - 1].joined != 0) {
+        last = labels[last - 1].joined;
+    }
+    if (labels[last - 1].location >= 0 || labels[other - 1].location >= 0) {
+        error("joining a label that is already placed in " + methodName);
+        return label;
+    }
+    labels[last - 1].joined = other;
+    return label;
+}
+
+// Branch relaxation, as javaa's RelaxBranches does it.  Every branch is
+// put in its own form with no offset yet, and when the method ends each
+// short one is checked against where its label ended up.  Any that don't
+// reach are widened: goto and jsr become goto_w and jsr_w, and a
+// conditional branch becomes the inverted condition jumping over a
+// goto_w.  Widening moves the code after it, which can push other
+// branches out of range, so this is repeated until nothing more needs
+// widening; then the code is rebuilt once with every offset filled in.
+
+// the length of a branch, widened or not
+int CodeGenerator::relaxedLength(const BranchSite &site) const {
+    int op = code[site.location];
+    if (JvmOp(op).operands == OPERANDS_BRANCH4) return 5;
+    if (!site.widened) return 3;
+    return JvmInvertBranch(op) < 0 ? 5 : 8;  // goto_w, or a branch around one
+}
+
+void CodeGenerator::relaxBranches() {
+    for (const BranchSite &site : branches) {
+        if (labels[site.label - 1].location == -1) {
+            error("branch to a label that was never placed in " + methodName);
+            return;
+        }
+    }
+    // shift[i] is how far branch i moves, and shift[n] how much the code grows
+    size_t n = branches.size();
+    std::vector<int> shift(n + 1, 0);
+    auto relaxedLocation = [&](int location) {
+        size_t before = std::lower_bound(branches.begin(), branches.end(), location,
+                                         [](const BranchSite &site, int at) { return site.location < at; })
+                        - branches.begin();
+        return location + shift[before];
+    };
+    bool changed;
+    do {
+        changed = false;
+        for (size_t i = 0; i < n; i++) {
+            shift[i + 1] = shift[i] + relaxedLength(branches[i]) -
+                           JvmOp(code[branches[i].location]).length;
+        }
+        for (size_t i = 0; i < n; i++) {
+            BranchSite &site = branches[i];
+            if (site.widened || JvmOp(code[site.location]).operands == OPERANDS_BRANCH4) continue;
+            int offset = relaxedLocation(labels[site.label - 1].location) - (site.location + shift[i]);
+            if (offset < -32768 || offset > 32767) {
+                site.widened = true;
+                changed = true;
+            }
+        }
+    } while (changed);
+
+    std::vector<uint8_t> relaxed;
+    relaxed.reserve(code.size() + shift[n]);
+    size_t from = 0;
+    for (const BranchSite &site : branches) {
+        relaxed.insert(relaxed.end(), code.begin() + from, code.begin() + site.location);
+        int at = relaxed.size();
+        int op = code[site.location];
+        int target = relaxedLocation(labels[site.label - 1].location);
+        if (JvmOp(op).operands == OPERANDS_BRANCH4) {
+            putU1(relaxed, op);
+            putU4(relaxed, (uint32_t)(target - at));
+        } else if (!site.widened) {
+            putU1(relaxed, op);
+            putU2(relaxed, target - at);
+        } else if (JvmInvertBranch(op) < 0) {
+            putU1(relaxed, op == OP_GOTO ? OP_GOTO_W : OP_JSR_W);
+            putU4(relaxed, (uint32_t)(target - at));
+        } else {
+            putU1(relaxed, JvmInvertBranch(op));
+            putU2(relaxed, 8);  // past the goto_w
+            putU1(relaxed, OP_GOTO_W);
+            putU4(relaxed, (uint32_t)(target - (at + 3)));
+        }
+        from = site.location + JvmOp(op).length;
+    }
+    relaxed.insert(relaxed.end(), code.begin() + from, code.end());
+    code.swap(relaxed);
+}
+
+void CodeGenerator::emitLabel(int label) {
+    narrowedEnd = -1;   // other code can get here with a float
+    for (; label != 0; label = labels[label - 1].joined) {
+        Label &l = labels[label - 1];
+        l.location = code.size();
+        // after a goto the depth is whatever the branches here bring
+        if (stackDepth < 0) {
+            stackDepth = (l.stackDepth < 0) ? 0 : l.stackDepth;
+        }
+        l.stackDepth = stackDepth;
+
+        if (listingCode()) {
+            emitTabs(); out << "L" << label << ":" << '\n';
+        }
+    }
+}
+
+void CodeGenerator::emitBranch(JvmOpcode op, int label) {
+    if (!JvmIsBranch(op)) {
+        error(std::string(JvmOp(op).mnemonic) + " is not a branch");
+        return;
+    }
+    Label &l = labels[label - 1];
+    branches.push_back({ (int)code.size(), label });
+    putU1(code, op);
+    if (JvmOp(op).operands == OPERANDS_BRANCH4) {
+        putU4(code, 0);
+    } else {
+        putU2(code, 0);
+    }
+    emitStack(JvmOp(op).pops, JvmOp(op).pushes);
+    if (l.stackDepth < 0) {
+        l.stackDepth = stackDepth;
+    }
+    if (op == OP_GOTO || op == OP_GOTO_W) {
+        stackDepth = -1;
+    } else if (op == OP_JSR || op == OP_JSR_W) {
+        stackDepth--;   // the subroutine takes its return address off again
+    }
+
+    if (!listingCode()) return;
+    emitTabs(); out << JvmOp(op).mnemonic << " L" << label << '\n';
 }
@@ -2,27 +2,184 @@
 #define CODE_GENERATION_H
 
 #include <string>
-#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <unordered_map>
+#include "opcode_table.h"
+#include "class_file.h"
+#include "interner.h"
+#include "function_table.h"
+#include "diagnostics.h"
 
+// A float as the listing writes it: the 9 significant digits that read
+// back as exactly that float, with a point or an exponent so that javaa
+// takes it for a real (1.5, 3.0, 1.00000001e-07).  No suffix.
+std::string realLiteral(float value);
+
+// Text gathered in memory and written to its file only when flush is
+// called (or the buffer is closed), so a listing costs a few large writes
+// rather than one per line
+class OutputBuffer {
+public:
+    ~OutputBuffer() { close(); }
+    // "-" is stdout, which close flushes but leaves open
+    bool open(const std::string &path);
+    bool is_open() const { return file != NULL; }
+    // what is gathered and not flushed yet, which truncate cuts back
+    size_t size() const { return data.size(); }
+    void truncate(size_t length) { data.resize(length); }
+    void flush();
+    void close();
+
+    OutputBuffer &operator<<(const std::string &text) { data.append(text); return *this; }
+    OutputBuffer &operator<<(const char *text) { data.append(text); return *this; }
+    OutputBuffer &operator<<(char c) { data.push_back(c); return *this; }
+    OutputBuffer &operator<<(int value);
+private:
+    FILE *file = NULL;
+    std::string data;
+};
+
+// Builds the class for one source file and writes <filename>.class when
+// it is destroyed.  With listing on, the same class is also written as
+// javaa assembly to <filename>.jasm (or listingPath), for reading or for
+// assembling with javaa.  A listing on stdout ("-") is flushed a method at
+// a time, so javaa at the other end of a pipe can assemble each one while
+// the next is generated; the .class is then left for javaa to write.
+// Types are given as they are spelled in the listing (int,
+// java.lang.String[], ...).  Misuse, such as a stack underflow or a
+// branch to a label never placed, is reported to diag as an error and the
+// instruction is left out; like any error, it means the class is to be
+// discarded.
 class CodeGenerator {
 public:
-    CodeGenerator(const std::string &filename); 
+    CodeGenerator(const std::string &filename, Diagnostics *diag,
+                  bool listing = false, const char *listingPath = NULL);
     ~CodeGenerator();
-    
+
     void emitClassStart(const std::string &class_name);
     void emitClassEnd();
     void emitField(const std::string &name, const std::string &type, const std::string &value);
     void emitMethod(const std::string &name, const std::string &returnType, const std::string &params);
+    // the same, remembering the member under its interned name for
+    // emitStaticField and emitInvokeStatic
+    void emitField(const Name *name, const std::string &type, const std::string &value);
+    void emitMethod(const Name *name, const std::string &returnType, const std::string &params);
+    // a declared function, whose descriptor is already worked out
+    void emitMethod(const Function *function);
     void emitMethodStart();
     void emitMethodEnd();
     void emitReturn();
+    // whether the next instruction can be reached (not after a return or
+    // goto, unless a label has been placed since)
+    bool reachable() const { return stackDepth >= 0; }
+    // leave the class unwritten, as when the source had errors
+    void discard() { discarded = true; }
 
-    void increaseTab() { tabCount++; }
-    void decreaseTab() { if (tabCount > 0) tabCount--; }
+    // one instruction; the operand is a bipush/sipush immediate, a local
+    // slot or a newarray type, as the opcode table says.  A load or store
+    // takes its short form or wide as the slot needs.
+    void emitInstruction(JvmOpcode op);
+    void emitInstruction(JvmOpcode op, int operand);
+    // takes back a d2f if it is the last thing emitted (with no label
+    // placed after it), leaving the double it narrowed on the stack;
+    // false if there is no such d2f
+    bool undoNarrowing();
+    // iinc of an int local, wide as the slot or amount needs
+    void emitIncrement(int slot, int amount);
+    // the shortest push of a constant: iconst_m1 to iconst_5, bipush,
+    // sipush or ldc for an int; fconst_0 to fconst_2 or ldc for a float
+    void emitConstant(int value);
+    void emitConstant(float value);
+    void emitConstant(const std::string &value);
+    // ldc of a constant pool entry
+    void emitLoadConstant(int value);
+    void emitLoadConstant(float value);
+    void emitLoadConstant(const std::string &value);
+    // getstatic/putstatic/getfield/putfield and the invokes; owner is a
+    // class name such as java.io.PrintStream
+    void emitFieldInstruction(JvmOpcode op, const std::string &type,
+                              const std::string &owner, const std::string &name);
+    void emitMethodInstruction(JvmOpcode op, const std::string &returnType,
+                               const std::string &owner, const std::string &name,
+                               const std::string &params);
+    // getstatic/putstatic of a field, and invokestatic of a method, of the
+    // class being generated; the constant is found through the name's hash
+    void emitStaticField(JvmOpcode op, const Name *name);
+    void emitInvokeStatic(const Name *name);
+
+    // labels are numbered per method from 1, so 0 can stand for none; a
+    // label can be branched to before it is placed
+    int newLabel();
+    void emitLabel(int label);
+    // one label for two that are not placed yet: placing it places both
+    int joinLabels(int label, int other);
+    void emitBranch(JvmOpcode op, int label);
+
+    void increaseTab() { indent.append(4, ' '); }
+    void decreaseTab() { if (!indent.empty()) indent.resize(indent.size() - 4); }
 private:
-    std::ofstream out;
-    int tabCount = 0;
+    // a field or method of this class, by interned name
+    struct Member {
+        std::string type;           // the field's type or the method's return type
+        std::string params;         // methods only
+        std::string descriptor;     // methods only
+        uint16_t ref = 0;           // its fieldref/methodref, 0 until used
+        int pops = 0;               // for invokestatic; getstatic pops nothing
+        int pushes = 0;
+    };
+    struct NameHash {
+        size_t operator()(const Name *name) const { return name->hash; }
+    };
+
+    struct Label {
+        int location = -1;          // -1 until emitLabel
+        int stackDepth = -1;        // on arriving at the label, -1 if unknown
+        int joined = 0;             // placed along with this one, 0 if none
+    };
+    // a branch instruction, whose offset is filled in when the method ends
+    struct BranchSite {
+        int location;               // of its opcode
+        int label;
+        bool widened = false;       // too far for a 2 byte offset
+    };
+
+    ClassFile *classFile;
+    std::string className;
+    Diagnostics *diag;
+    OutputBuffer out;
+    bool listing;
+    bool discarded = false;
+    bool writeClass = true;         // false when javaa makes it from the listing
+    bool inMethod = false;          // code outside a method (a global's
+                                    // initializer) is not listed or kept
+    std::string indent;             // four spaces a level, kept as it changes
+
+    // the method being generated
+    std::string methodName;
+    std::string methodType;
+    std::vector<uint8_t> code;
+    std::vector<Label> labels;
+    std::vector<BranchSite> branches;   // in code order
+
+    std::unordered_map<const Name *, Member, NameHash> fields;
+    std::unordered_map<const Name *, Member, NameHash> methods;
+    int stackDepth = 0;             // -1 after goto/return until a label
+    int maxStack = 0;
+    int maxLocals = 0;
+    int narrowedEnd = -1;           // the code's size just after a d2f, -1 once a label follows
+    size_t narrowedListing = 0;     // the listing's size before that d2f
+
     void emitTabs();
+    void error(const std::string &message);
+    bool listingCode() const { return listing && inMethod; }
+    void emitMethod(const std::string &name, const std::string &returnType, const std::string &params,
+                    const std::string &descriptor, int argWords);
+    void emitStack(int pops, int pushes);
+    void useLocal(int slot, int words);
+    void emitConstantIndex(uint16_t index);
+    int relaxedLength(const BranchSite &site) const;
+    void relaxBranches();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,62 @@
+#ifndef COMPILE_CONTEXT_H
+#define COMPILE_CONTEXT_H
+
+#include <stdbool.h>
+
+#include "symbol_table.h"
+#include "function_table.h"
+#include "arena.h"
+#include "interner.h"
+#include "expr_value.h"
+#include "source.h"
+#include "diagnostics.h"
+
+class CodeGenerator;
+
+// The call whose arguments are being pushed: the function (NULL if none is
+// declared by that name) and the parameter the next argument is for
+typedef struct CallSite {
+    const Function *function;
+    int argument;
+} CallSite;
+
+// Where the end of a loop's body goes back to, and the label after the
+// loop (0 if nothing leaves it)
+typedef struct LoopLabels {
+    int repeat;
+    int exit;
+} LoopLabels;
+
+// Everything one compilation works on.  The scanner (reentrant flex) and
+// the parser (pure bison) reach their state only through this, and every
+// error but running out of memory goes to its diag, so several threads can
+// each compile a program with a context of their own.
+typedef struct CompileContext {
+    void *scanner;                  // the flex yyscan_t, whose extra is this
+    SourceBuffer source;            // scanned in place; tokens are spans of it
+    SpanTable tokens;               // where each token scanned so far is
+    Diagnostics diag;               // messages, progress and dumps
+    int linenum;
+    unsigned int lineStart;         // offset of the line being scanned
+    unsigned int commentStart;      // offset of the comment text on this line
+
+    // string literals, expression values, declarator and parameter lists
+    Arena *arena;
+    ArenaMark functionMark;         // released when the function ends
+
+    // identifiers and type names; type names are tagged with their ExprType
+    Interner *names;
+    const Name *typeNames[EXPR_TYPE_COUNT]; // int, float, bool, ... by ExprType
+
+    SymbolTable *symbolTable;      // every open scope
+    FunctionTable *functionTable;
+    CodeGenerator *codeGen;
+    CallSite call;                  // the innermost call being parsed
+
+    // Helper variables for function return type checking
+    const Name *current_function_name_for_return_check;
+    const Name *current_function_return_type_for_return_check; // Stores "int", "float", "void", etc.
+    bool non_void_function_has_return_value_statement; // True if a 'return <expr>;' was found and type-checked
+} CompileContext;
+
+#endif
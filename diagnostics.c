@@ -0,0 +1,246 @@
+#include "diagnostics.h"
+
+#include <stdarg.h>
+
+// a buffer is written out once it holds this much
+#define DIAGNOSTIC_FLUSH_SIZE 65536
+// at most this much of a source line is shown, around the token
+#define SOURCE_LINE_WINDOW 120
+
+static void initBuffer(DiagnosticBuffer *buffer, FILE *file) {
+    buffer->file = file;
+    buffer->data = NULL;
+    buffer->used = 0;
+    buffer->capacity = 0;
+}
+
+static void flushBuffer(DiagnosticBuffer *buffer) {
+    if (buffer->used > 0) {
+        fwrite(buffer->data, 1, buffer->used, buffer->file);
+        buffer->used = 0;
+    }
+    fflush(buffer->file);
+}
+
+// Make room for size more bytes
+static char* reserve(DiagnosticBuffer *buffer, size_t size) {
+    if (buffer->capacity - buffer->used < size) {
+        size_t capacity = buffer->capacity ? buffer->capacity : DIAGNOSTIC_FLUSH_SIZE;
+        while (capacity - buffer->used < size) capacity *= 2;
+        buffer->data = (char *)realloc(buffer->data, capacity);
+        buffer->capacity = capacity;
+    }
+    return buffer->data + buffer->used;
+}
+
+static void put(DiagnosticBuffer *buffer, const char *text, size_t length) {
+    memcpy(reserve(buffer, length), text, length);
+    buffer->used += length;
+}
+
+#define putLiteral(buffer, text) put(buffer, text, sizeof(text) - 1)
+
+static void putChar(DiagnosticBuffer *buffer, char c) {
+    *reserve(buffer, 1) = c;
+    buffer->used++;
+}
+
+static void putFormat(DiagnosticBuffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t room = buffer->capacity - buffer->used;
+    int length = vsnprintf(buffer->data ? buffer->data + buffer->used : NULL, room, format, args);
+    va_end(args);
+    if (length >= 0 && (size_t)length >= room) {
+        va_start(args, format);
+        vsnprintf(reserve(buffer, length + 1), length + 1, format, args);
+        va_end(args);
+    }
+    if (length > 0) buffer->used += length;
+}
+
+// a JSON string, quotes and all
+static void putJsonString(DiagnosticBuffer *buffer, const char *text, size_t length) {
+    putChar(buffer, '"');
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            putChar(buffer, '\\');
+            putChar(buffer, c);
+        } else if (c == '\n') {
+            putLiteral(buffer, "\\n");
+        } else if (c == '\t') {
+            putLiteral(buffer, "\\t");
+        } else if (c < 0x20) {
+            putFormat(buffer, "\\u%04x", c);
+        } else {
+            putChar(buffer, c);
+        }
+    }
+    putChar(buffer, '"');
+}
+
+// the start of every JSON line: {"file":"...","level":"..."
+static void beginJson(Diagnostics *diag, DiagnosticBuffer *buffer, const char *level) {
+    putLiteral(buffer, "{\"file\":");
+    putJsonString(buffer, diag->file, strlen(diag->file));
+    putFormat(buffer, ",\"level\":\"%s\"", level);
+}
+
+// Write a full buffer out; messages never span two writes
+static void endEntry(DiagnosticBuffer *buffer) {
+    if (buffer->used >= DIAGNOSTIC_FLUSH_SIZE) {
+        flushBuffer(buffer);
+    }
+}
+
+//-------------------------------------------------------------
+
+void initDiagnostics(Diagnostics *diag, DiagnosticOptions options, const char *file,
+                     const SourceBuffer *source) {
+    diag->options = options;
+    diag->file = file;
+    diag->source = source;
+    diag->errors = 0;
+    if (options.stream != NULL) {
+        initBuffer(&diag->out, options.stream);
+        initBuffer(&diag->err, options.stream);
+    } else {
+        initBuffer(&diag->out, options.allToStderr ? stderr : stdout);
+        initBuffer(&diag->err, stderr);
+    }
+}
+
+void flushDiagnostics(Diagnostics *diag) {
+    flushBuffer(&diag->out);
+    flushBuffer(&diag->err);
+}
+
+void closeDiagnostics(Diagnostics *diag) {
+    flushDiagnostics(diag);
+    free(diag->out.data);
+    free(diag->err.data);
+    diag->out.data = diag->err.data = NULL;
+    diag->out.capacity = diag->err.capacity = 0;
+}
+
+// The line at is on, with a marker under the token; a long (generated)
+// line is cut down to a window that shows the token
+static void putSourceLine(DiagnosticBuffer *buffer, const SourceBuffer *source, const TokenSpan *at) {
+    if (at == NULL || source == NULL || at->offset > source->length) return;
+    const char *token = source->text + at->offset;
+    const char *start = token - (at->column - 1);
+    const char *end = token;
+    const char *limit = source->text + source->length;
+    while (end < limit && *end != '\n' && *end != '\r') end++;
+
+    const char *before = "", *after = "";
+    if (token - start > SOURCE_LINE_WINDOW / 2) {
+        start = token - SOURCE_LINE_WINDOW / 2;
+        before = "...";
+    }
+    if (end - start > SOURCE_LINE_WINDOW) {
+        end = start + SOURCE_LINE_WINDOW;
+        after = "...";
+    }
+    // by length, as the text need not end in a NUL (or be free of them)
+    putFormat(buffer, "    %s", before);
+    put(buffer, start, end - start);
+    putFormat(buffer, "%s\n    %s", after, before[0] ? "   " : "");
+    // keep tabs, so the marker lines up with the text above it
+    for (const char *p = start; p < token; p++) {
+        putChar(buffer, *p == '\t' ? '\t' : ' ');
+    }
+    putChar(buffer, '^');
+    for (unsigned int i = 1; i < at->length && token + i < end; i++) {
+        putChar(buffer, '~');
+    }
+    putChar(buffer, '\n');
+}
+
+void reportMessage(Diagnostics *diag, DiagnosticLevel level, int line,
+                   const TokenSpan *at, const char *message) {
+    if (level == DIAG_ERROR) {
+        diag->errors++;
+    }
+    if (!wantsDiagnostic(diag, level)) return;
+    const char *name = level == DIAG_ERROR ? "error" : "warning";
+    DiagnosticBuffer *buffer = &diag->err;
+    if (diag->options.json) {
+        beginJson(diag, buffer, name);
+        if (line > 0) putFormat(buffer, ",\"line\":%d", line);
+        if (at != NULL) putFormat(buffer, ",\"column\":%u", at->column);
+        putLiteral(buffer, ",\"message\":");
+        putJsonString(buffer, message, strlen(message));
+        putLiteral(buffer, "}\n");
+    } else {
+        const char *label = level == DIAG_ERROR ? "Error" : "Warning";
+        if (line > 0) {
+            putFormat(buffer, "%s at line %d: %s\n", label, line, message);
+        } else {
+            putFormat(buffer, "%s: %s\n", label, message);
+        }
+        putSourceLine(buffer, diag->source, at);
+    }
+    endEntry(buffer);
+}
+
+void reportProgress(Diagnostics *diag, const char *message) {
+    if (!wantsDiagnostic(diag, DIAG_PROGRESS)) return;
+    DiagnosticBuffer *buffer = &diag->out;
+    if (diag->options.json) {
+        beginJson(diag, buffer, "progress");
+        putLiteral(buffer, ",\"message\":");
+        putJsonString(buffer, message, strlen(message));
+        putLiteral(buffer, "}\n");
+    } else {
+        putFormat(buffer, "%s\n", message);
+    }
+    endEntry(buffer);
+}
+
+void reportComment(Diagnostics *diag, int line, const char *text, size_t length) {
+    if (!wantsDiagnostic(diag, DIAG_DUMP)) return;
+    DiagnosticBuffer *buffer = &diag->out;
+    if (diag->options.json) {
+        beginJson(diag, buffer, "dump");
+        putFormat(buffer, ",\"kind\":\"comment\",\"line\":%d,\"text\":", line);
+        putJsonString(buffer, text, length);
+        putLiteral(buffer, "}\n");
+    } else {
+        putFormat(buffer, "Line%d: %.*s\n", line, (int)length, text);
+    }
+    endEntry(buffer);
+}
+
+void beginScopeDump(Diagnostics *diag) {
+    DiagnosticBuffer *buffer = &diag->out;
+    if (diag->options.json) {
+        beginJson(diag, buffer, "dump");
+        putLiteral(buffer, ",\"kind\":\"scope\",\"symbols\":[");
+    } else {
+        putLiteral(buffer, "Symbol Table:\n");
+    }
+}
+
+void reportSymbol(Diagnostics *diag, const char *name, const char *type, bool isConst) {
+    DiagnosticBuffer *buffer = &diag->out;
+    if (diag->options.json) {
+        if (buffer->data[buffer->used - 1] != '[') putChar(buffer, ',');
+        putLiteral(buffer, "{\"name\":");
+        putJsonString(buffer, name, strlen(name));
+        putLiteral(buffer, ",\"type\":");
+        putJsonString(buffer, type, strlen(type));
+        putFormat(buffer, ",\"const\":%s}", isConst ? "true" : "false");
+    } else {
+        putFormat(buffer, " Name: %s, Type: %s%s\n", name, type, isConst ? "(const)" : "");
+    }
+}
+
+void endScopeDump(Diagnostics *diag) {
+    DiagnosticBuffer *buffer = &diag->out;
+    if (diag->options.json) {
+        putLiteral(buffer, "]}\n");
+    }
+    endEntry(buffer);
+}
@@ -0,0 +1,71 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "source.h"
+
+// How much a compilation reports; each level includes the ones above it
+typedef enum DiagnosticLevel {
+    DIAG_ERROR,
+    DIAG_WARNING,
+    DIAG_PROGRESS,              // Starting parsing..., Parsing done.
+    DIAG_DUMP                   // every scope's symbols and every comment
+} DiagnosticLevel;
+
+typedef struct DiagnosticOptions {
+    DiagnosticLevel level;      // DIAG_PROGRESS unless asked otherwise
+    bool json;                  // one JSON object per line instead of text
+    bool allToStderr;           // stdout carries something else, such as the listing
+    FILE *stream;               // if set, everything goes here instead, such
+                                // as a batch job's own file
+} DiagnosticOptions;
+
+// Text on its way to a stream, written out in large pieces
+typedef struct DiagnosticBuffer {
+    FILE *file;
+    char *data;
+    size_t used;
+    size_t capacity;
+} DiagnosticBuffer;
+
+// Where one compilation's messages go.  Errors and warnings are for
+// stderr and the rest for stdout (unless allToStderr), as before, but both
+// are held until a buffer fills or the compilation ends.
+typedef struct Diagnostics {
+    DiagnosticOptions options;
+    const char *file;           // the source file's name, for JSON
+    const SourceBuffer *source; // for showing the line a message is about
+    DiagnosticBuffer out;
+    DiagnosticBuffer err;
+    int errors;                 // errors reported, shown or not
+} Diagnostics;
+
+void initDiagnostics(Diagnostics *diag, DiagnosticOptions options, const char *file,
+                     const SourceBuffer *source);
+// flushes, then frees the buffers
+void closeDiagnostics(Diagnostics *diag);
+void flushDiagnostics(Diagnostics *diag);
+
+static inline bool wantsDiagnostic(const Diagnostics *diag, DiagnosticLevel level) {
+    return level <= diag->options.level;
+}
+
+// An error or warning at line, showing the source around the token at
+// (which may be NULL); an error is counted even when it is not shown.
+// Line 0 is for one about no line in particular, such as a class file
+// limit.
+void reportMessage(Diagnostics *diag, DiagnosticLevel level, int line,
+                   const TokenSpan *at, const char *message);
+void reportProgress(Diagnostics *diag, const char *message);
+// a comment's text on one line, without its newline
+void reportComment(Diagnostics *diag, int line, const char *text, size_t length);
+// a scope's symbols: beginScopeDump, reportSymbol for each, endScopeDump
+void beginScopeDump(Diagnostics *diag);
+void reportSymbol(Diagnostics *diag, const char *name, const char *type, bool isConst);
+void endScopeDump(Diagnostics *diag);
+
+#endif
@@ -1,10 +1,180 @@
 #ifndef EXPR_VALUE_H
 #define EXPR_VALUE_H
 
-// Define a named struct for expression results
+#include <string.h>
+#include <stdbool.h>
+#include "opcode_table.h"
+
+// The types an expression can have.  TYPE_ERROR is zero, so a zeroed
+// ExprValue is an error value.
+typedef enum ExprType {
+    TYPE_ERROR = 0,
+    TYPE_INT,
+    TYPE_REAL,
+    TYPE_BOOL,
+    TYPE_STRING,
+    TYPE_VOID,              // only the result of a void function
+    EXPR_TYPE_COUNT
+} ExprType;
+
+// An expression's type and, when it is known at compile time, its value.
+// Nothing in it is allocated; a string points at the literal's text.  A
+// known value has no code until something needs it on the stack, so it
+// can still be folded; any other value (but an error or a void) has had
+// its code emitted, and is on top of the operand stack.
+//
+// A bool can instead be a condition, kept in jump form so that if and
+// while can branch on it without making a value of it first: its code
+// either jumps to trueLabel or falseLabel, or falls through to branch,
+// which is not emitted yet and is taken when the bool is true (its
+// operands are what is on the stack).  Labels are 0 where nothing jumps.
+// Only a branch on a bool value has a 0 or 1 to test; a comparison's
+// leaves whatever fcmpl or compareTo gave.
 typedef struct ExprValue {
-    char *type;
-    void *value;
+    ExprType type;
+    bool known;             // the union holds the value
+    JvmOpcode branch;       // a condition's last test, OP_NOP for a value
+    bool testsBool;         // branch is ifne or ifeq of a 0 or 1
+    int trueLabel;
+    int falseLabel;
+    union {
+        int intValue;
+        float realValue;
+        bool boolValue;
+        const char *stringValue;
+    };
 } ExprValue;
 
-#endif
\ No newline at end of file
+// The expression type of a declared type (int, float, double, ...), or
+// TYPE_ERROR for one no expression has
+static inline ExprType exprTypeFromName(const char *typeName) {
+    if (strcmp(typeName, "int") == 0) return TYPE_INT;
+    if (strcmp(typeName, "float") == 0 || strcmp(typeName, "double") == 0) return TYPE_REAL;
+    if (strcmp(typeName, "bool") == 0) return TYPE_BOOL;
+    if (strcmp(typeName, "string") == 0 || strcmp(typeName, "char") == 0) return TYPE_STRING;
+    if (strcmp(typeName, "void") == 0) return TYPE_VOID;
+    return TYPE_ERROR;
+}
+
+// The declared type spelling of an expression type
+static inline const char *exprTypeName(ExprType type) {
+    static const char *names[EXPR_TYPE_COUNT] = { "error", "int", "float", "bool", "string", "void" };
+    return names[type];
+}
+
+//-------------------------------------------------------------
+
+typedef enum BinaryOp {
+    BIN_ADD, BIN_SUB, BIN_MUL, BIN_DIV, BIN_MOD,
+    BIN_LT, BIN_LEQ, BIN_EQ, BIN_GEQ, BIN_GT, BIN_NEQ,
+    BIN_AND, BIN_OR,
+    BINARY_OP_COUNT
+} BinaryOp;
+
+typedef enum UnaryOp {
+    UN_NEG, UN_NOT, UN_INC, UN_DEC,
+    UNARY_OP_COUNT
+} UnaryOp;
+
+// operands that are ints to be converted (i2f) before the opcode
+#define WIDEN_LEFT 1
+#define WIDEN_RIGHT 2
+
+// What an operator does with a pair of operand types.  The opcode is the
+// instruction applied to the (converted) operands: iadd, fmul, iand, ...
+// For a comparison it leaves an int for branch to test: fcmpl/fcmpg, or
+// invokevirtual for String.compareTo; it is nop for ints, where branch is
+// the if_icmp<cond> itself.  String + is invokevirtual for String.concat.
+typedef struct BinaryRule {
+    ExprType result;        // TYPE_ERROR if the operands don't go together
+    JvmOpcode opcode;
+    JvmOpcode branch;       // comparisons only: taken when the result is true
+    unsigned char widen;
+} BinaryRule;
+
+typedef struct UnaryRule {
+    ExprType result;        // TYPE_ERROR if the operand doesn't fit
+    JvmOpcode opcode;       // ineg, fneg; ixor (with 1) for !; iadd or fadd (of 1)
+} UnaryRule;
+
+struct BinaryRuleTable {
+    BinaryRule rules[BINARY_OP_COUNT][EXPR_TYPE_COUNT][EXPR_TYPE_COUNT];
+};
+
+struct UnaryRuleTable {
+    UnaryRule rules[UNARY_OP_COUNT][EXPR_TYPE_COUNT];
+};
+
+constexpr BinaryRuleTable buildBinaryRules() {
+    BinaryRuleTable t = {};
+    const JvmOpcode intOps[] = { OP_IADD, OP_ISUB, OP_IMUL, OP_IDIV };
+    const JvmOpcode realOps[] = { OP_FADD, OP_FSUB, OP_FMUL, OP_FDIV };
+    for (int op = BIN_ADD; op <= BIN_DIV; op++) {
+        t.rules[op][TYPE_INT][TYPE_INT] = { TYPE_INT, intOps[op], OP_NOP, 0 };
+        t.rules[op][TYPE_INT][TYPE_REAL] = { TYPE_REAL, realOps[op], OP_NOP, WIDEN_LEFT };
+        t.rules[op][TYPE_REAL][TYPE_INT] = { TYPE_REAL, realOps[op], OP_NOP, WIDEN_RIGHT };
+        t.rules[op][TYPE_REAL][TYPE_REAL] = { TYPE_REAL, realOps[op], OP_NOP, 0 };
+    }
+    t.rules[BIN_ADD][TYPE_STRING][TYPE_STRING] = { TYPE_STRING, OP_INVOKEVIRTUAL, OP_NOP, 0 };
+    t.rules[BIN_MOD][TYPE_INT][TYPE_INT] = { TYPE_INT, OP_IREM, OP_NOP, 0 };
+
+    // indexed from BIN_LT; a NaN operand makes every comparison but != false
+    const JvmOpcode intBranches[] = { OP_IF_ICMPLT, OP_IF_ICMPLE, OP_IF_ICMPEQ, OP_IF_ICMPGE, OP_IF_ICMPGT, OP_IF_ICMPNE };
+    const JvmOpcode branches[] = { OP_IFLT, OP_IFLE, OP_IFEQ, OP_IFGE, OP_IFGT, OP_IFNE };
+    const JvmOpcode realCompares[] = { OP_FCMPG, OP_FCMPG, OP_FCMPL, OP_FCMPL, OP_FCMPL, OP_FCMPL };
+    for (int op = BIN_LT; op <= BIN_NEQ; op++) {
+        int i = op - BIN_LT;
+        t.rules[op][TYPE_INT][TYPE_INT] = { TYPE_BOOL, OP_NOP, intBranches[i], 0 };
+        t.rules[op][TYPE_INT][TYPE_REAL] = { TYPE_BOOL, realCompares[i], branches[i], WIDEN_LEFT };
+        t.rules[op][TYPE_REAL][TYPE_INT] = { TYPE_BOOL, realCompares[i], branches[i], WIDEN_RIGHT };
+        t.rules[op][TYPE_REAL][TYPE_REAL] = { TYPE_BOOL, realCompares[i], branches[i], 0 };
+        t.rules[op][TYPE_STRING][TYPE_STRING] = { TYPE_BOOL, OP_INVOKEVIRTUAL, branches[i], 0 };
+    }
+
+    t.rules[BIN_AND][TYPE_BOOL][TYPE_BOOL] = { TYPE_BOOL, OP_IAND, OP_NOP, 0 };
+    t.rules[BIN_OR][TYPE_BOOL][TYPE_BOOL] = { TYPE_BOOL, OP_IOR, OP_NOP, 0 };
+    return t;
+}
+
+constexpr UnaryRuleTable buildUnaryRules() {
+    UnaryRuleTable t = {};
+    t.rules[UN_NEG][TYPE_INT] = { TYPE_INT, OP_INEG };
+    t.rules[UN_NEG][TYPE_REAL] = { TYPE_REAL, OP_FNEG };
+    t.rules[UN_NOT][TYPE_BOOL] = { TYPE_BOOL, OP_IXOR };
+    t.rules[UN_INC][TYPE_INT] = { TYPE_INT, OP_IADD };
+    t.rules[UN_INC][TYPE_REAL] = { TYPE_REAL, OP_FADD };
+    t.rules[UN_DEC][TYPE_INT] = { TYPE_INT, OP_ISUB };
+    t.rules[UN_DEC][TYPE_REAL] = { TYPE_REAL, OP_FSUB };
+    return t;
+}
+
+constexpr BinaryRuleTable BinaryRules = buildBinaryRules();
+constexpr UnaryRuleTable UnaryRules = buildUnaryRules();
+
+constexpr const BinaryRule &binaryRule(BinaryOp op, ExprType left, ExprType right) {
+    return BinaryRules.rules[op][left][right];
+}
+
+constexpr const UnaryRule &unaryRule(UnaryOp op, ExprType operand) {
+    return UnaryRules.rules[op][operand];
+}
+
+static_assert(binaryRule(BIN_MUL, TYPE_INT, TYPE_REAL).result == TYPE_REAL &&
+              binaryRule(BIN_MUL, TYPE_INT, TYPE_REAL).widen == WIDEN_LEFT &&
+              binaryRule(BIN_MOD, TYPE_REAL, TYPE_INT).result == TYPE_ERROR &&
+              binaryRule(BIN_GEQ, TYPE_INT, TYPE_INT).branch == OP_IF_ICMPGE &&
+              binaryRule(BIN_OR, TYPE_BOOL, TYPE_INT).result == TYPE_ERROR,
+              "operator rules");
+
+// for messages: "Type mismatch in <name>"
+static inline const char *binaryOpName(BinaryOp op) {
+    static const char *names[BINARY_OP_COUNT] = {
+        "addition", "subtraction", "multiplication", "division", "modulus",
+        "less than comparison", "less equal comparison", "equal comparison",
+        "greater equal comparison", "greater than comparison", "not equal comparison",
+        "logical AND", "logical OR"
+    };
+    return names[op];
+}
+
+#endif
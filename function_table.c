@@ -1,55 +1,94 @@
 #include "function_table.h"
 
-// Hash function
-unsigned int hashForFunctions(const char *key) {
-    unsigned int hash = 0;
-    while (*key) {
-        hash = (hash << 5) + *key++;
-    }
-    return hash % HASH_SIZE;
-}
+#define FUNCTION_TABLE_INITIAL_CAPACITY 64
 
 FunctionTable* createFunctionTable() {
     FunctionTable *table = (FunctionTable *)malloc(sizeof(FunctionTable));
-    for (int i = 0; i < HASH_SIZE; i++) {
-        table->table[i] = NULL;
-    }
+    table->capacity = FUNCTION_TABLE_INITIAL_CAPACITY;
+    table->count = 0;
+    table->slots = (Function **)calloc(table->capacity, sizeof(Function *));
+    table->arena = createArena();
     return table;
 }
 
-void insertFunction(FunctionTable *table, const char *name, const char *type, Parameter *parameters) {
-    unsigned int index = hashForFunctions(name);
-    Function *function = (Function *)malloc(sizeof(Function));
-    function->name = strdup(name);
-    function->type = strdup(type);
-    function->parameters = parameters;
+// The slot of name, or the free slot it would go in
+static Function** findSlot(Function **slots, unsigned int capacity, const Name *name) {
+    unsigned int index = name->hash & (capacity - 1);
+    while (slots[index] != NULL && slots[index]->name != name) { // names are interned
+        index = (index + 1) & (capacity - 1);
+    }
+    return &slots[index];
+}
 
-    function->next = table->table[index]; // insert at the beginning of the linked list
-    table->table[index] = function;
+// Double the table, which keeps it at most half full
+static void growFunctionTable(FunctionTable *table) {
+    unsigned int capacity = table->capacity * 2;
+    Function **slots = (Function **)calloc(capacity, sizeof(Function *));
+    for (unsigned int i = 0; i < table->capacity; i++) {
+        if (table->slots[i] == NULL) continue;
+        *findSlot(slots, capacity, table->slots[i]->name) = table->slots[i];
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
 }
 
-Function* lookupFunction(FunctionTable *table, const char *name) {
-    unsigned int index = hashForFunctions(name);
-    Function *function = table->table[index];
-    while (function != NULL) {
-        if (strcmp(function->name, name) == 0) {
-            return function; // find
-        }
-        function = function->next;
+// the JVM descriptor of a declared type; a char holds a string
+static const char* typeDescriptor(const Name *type) {
+    static const struct { const char *type; const char *descriptor; } descriptors[] = {
+        { "int", "I" }, { "float", "F" }, { "double", "D" }, { "char", "Ljava/lang/String;" },
+        { "bool", "Z" }, { "string", "Ljava/lang/String;" }, { "void", "V" }
+    };
+    for (size_t i = 0; i < sizeof(descriptors) / sizeof(descriptors[0]); i++) {
+        if (strcmp(type->text, descriptors[i].type) == 0) return descriptors[i].descriptor;
     }
-    return NULL; // not found
+    return "V";
 }
 
-void deleteFunctionTable(FunctionTable *table) {
-    for (int i = 0; i < HASH_SIZE; i++) {
-        Function *function = table->table[i];
-        while (function != NULL) {
-            Function *temp = function;
-            function = function->next;
-            free(temp->name);
-            free(temp->type);
-            free(temp);
-        }
+Function* insertFunction(FunctionTable *table, const Name *name, const Name *type, Parameter *parameters) {
+    Function *function = (Function *)arenaAlloc(table->arena, sizeof(Function));
+    function->name = name;
+    function->type = type;
+    function->arity = 0;
+    size_t descriptorLength = strlen(typeDescriptor(type)) + 3;
+    for (Parameter *param = parameters; param != NULL; param = param->next) {
+        function->arity++;
+        descriptorLength += strlen(typeDescriptor(param->type));
+    }
+
+    const Name **paramTypes = (const Name **)arenaAlloc(table->arena, function->arity * sizeof(const Name *));
+    char *descriptor = (char *)arenaAlloc(table->arena, descriptorLength);
+    char *end = descriptor;
+    *end++ = '(';
+    function->argWords = 0;
+    int i = 0;
+    for (Parameter *param = parameters; param != NULL; param = param->next) {
+        const char *paramDescriptor = typeDescriptor(param->type);
+        paramTypes[i++] = param->type;
+        end = stpcpy(end, paramDescriptor);
+        function->argWords += strcmp(paramDescriptor, "D") == 0 ? 2 : 1;
     }
+    *end++ = ')';
+    strcpy(end, typeDescriptor(type));
+    function->paramTypes = paramTypes;
+    function->descriptor = descriptor;
+
+    Function **slot = findSlot(table->slots, table->capacity, name);
+    bool isNew = *slot == NULL;
+    *slot = function; // a redeclaration replaces the old one
+    if (isNew && ++table->count * 2 > table->capacity) {
+        growFunctionTable(table);
+    }
+    return function;
+}
+
+Function* lookupFunction(FunctionTable *table, const Name *name) {
+    return *findSlot(table->slots, table->capacity, name); // NULL if not found
+}
+
+void deleteFunctionTable(FunctionTable *table) {
+    if (table == NULL) return;
+    free(table->slots);
+    deleteArena(table->arena);
     free(table);
-}
\ No newline at end of file
+}
@@ -6,32 +6,46 @@
 #include <string.h>
 #include <stdbool.h>
 
-#define HASH_SIZE 211
+#include "interner.h"
+#include "arena.h"
 
 typedef struct Parameter {
-    char *name;
-    char *type;
+    const Name *name;
+    const Name *type;
     struct Parameter *next;
 } Parameter;
 
-typedef struct Function {
-    char *name;
-    char *type;
-    Parameter *parameters; // linked list of parameters
+// A list built left to right, so it keeps its last parameter as well
+typedef struct ParameterList {
+    Parameter *head;
+    Parameter *tail;
+} ParameterList;
 
-    struct Function *next; // for collision resolution
+// A function and its signature, laid out flat when it is declared so a
+// call is checked against an array rather than a parameter list
+typedef struct Function {
+    const Name *name;
+    const Name *type;           // return type
+    int arity;
+    const Name **paramTypes;    // arity declared types, in order
+    const char *descriptor;     // JVM method descriptor, such as (IF)V
+    int argWords;               // stack words the arguments take
 } Function;
 
+// Open addressing table of the declared functions, resized as it fills.
+// Functions and their signatures live in the table's own arena.
 typedef struct FunctionTable {
-    Function *table[HASH_SIZE];
+    Function **slots;           // capacity is a power of two, NULL if free
+    unsigned int capacity;
+    unsigned int count;
+    Arena *arena;
 } FunctionTable;
 
 
 FunctionTable* createFunctionTable();
-void insertFunction(FunctionTable *table, const char *name, const char *type, Parameter *parameters);
-Function* lookupFunction(FunctionTable *table, const char *name);
+Function* insertFunction(FunctionTable *table, const Name *name, const Name *type, Parameter *parameters);
+Function* lookupFunction(FunctionTable *table, const Name *name);
 void deleteFunctionTable(FunctionTable *table);
 
-unsigned int hashForFunctions(const char *key);
 
-#endif
\ No newline at end of file
+#endif
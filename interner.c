@@ -0,0 +1,84 @@
+#include "interner.h"
+
+#define INTERNER_INITIAL_CAPACITY 256
+
+// FNV-1a
+unsigned int hashString(const char *text, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+Interner* createInterner() {
+    Interner *interner = (Interner *)malloc(sizeof(Interner));
+    interner->capacity = INTERNER_INITIAL_CAPACITY;
+    interner->count = 0;
+    interner->slots = (const Name **)calloc(interner->capacity, sizeof(const Name *));
+    interner->arena = createArena();
+    return interner;
+}
+
+// Double the table, which keeps it at most half full
+static void growInterner(Interner *interner) {
+    unsigned int capacity = interner->capacity * 2;
+    const Name **slots = (const Name **)calloc(capacity, sizeof(const Name *));
+    for (unsigned int i = 0; i < interner->capacity; i++) {
+        const Name *name = interner->slots[i];
+        if (name == NULL) continue;
+        unsigned int index = name->hash & (capacity - 1);
+        while (slots[index] != NULL) {
+            index = (index + 1) & (capacity - 1);
+        }
+        slots[index] = name;
+    }
+    free(interner->slots);
+    interner->slots = slots;
+    interner->capacity = capacity;
+}
+
+const Name* internLength(Interner *interner, const char *text, size_t length) {
+    unsigned int hash = hashString(text, length);
+    unsigned int index = hash & (interner->capacity - 1);
+    const Name *name;
+    while ((name = interner->slots[index]) != NULL) {
+        if (name->hash == hash && name->length == length &&
+            memcmp(name->text, text, length) == 0) {
+            return name; // seen before
+        }
+        index = (index + 1) & (interner->capacity - 1);
+    }
+
+    char *copy = (char *)arenaAlloc(interner->arena, length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    Name *newName = (Name *)arenaAlloc(interner->arena, sizeof(Name));
+    newName->text = copy;
+    newName->length = (unsigned int)length;
+    newName->hash = hash;
+    newName->tag = 0;
+    interner->slots[index] = newName;
+    if (++interner->count * 2 > interner->capacity) {
+        growInterner(interner);
+    }
+    return newName;
+}
+
+const Name* intern(Interner *interner, const char *text) {
+    return internLength(interner, text, strlen(text));
+}
+
+const Name* internTagged(Interner *interner, const char *text, int tag) {
+    const Name *name = intern(interner, text);
+    ((Name *)name)->tag = tag; // the interner owns it
+    return name;
+}
+
+void deleteInterner(Interner *interner) {
+    if (interner == NULL) return;
+    free(interner->slots);
+    deleteArena(interner->arena);
+    free(interner);
+}
@@ -0,0 +1,39 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// An interned identifier or type name.  The interner hands each distinct
+// spelling out once, so two names are the same exactly when their handles
+// (const Name *) are, and the hash is worked out only when a name is first
+// seen.
+typedef struct Name {
+    const char *text;
+    unsigned int length;
+    unsigned int hash;
+    int tag;                  // what internTagged set, else 0
+} Name;
+
+// Open addressing table of the names of one compilation.  Names and their
+// text live in the interner's own arena until it is deleted.
+typedef struct Interner {
+    const Name **slots;       // capacity is a power of two, NULL if free
+    unsigned int capacity;
+    unsigned int count;
+    Arena *arena;
+} Interner;
+
+Interner* createInterner();
+const Name* intern(Interner *interner, const char *text);
+const Name* internLength(Interner *interner, const char *text, size_t length);
+// interns text and sets its tag, such as the ExprType of a type name
+const Name* internTagged(Interner *interner, const char *text, int tag);
+void deleteInterner(Interner *interner);
+
+unsigned int hashString(const char *text, size_t length);
+
+#endif
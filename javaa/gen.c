@@ -8,6 +8,7 @@
 #include "build.h"
 #include "gram.h"
 #include "listing.h"
+#include "../opcode_table.h"
 
 #define CONSTANT_Class -10
 #define CONSTANT_Fieldref -11
@@ -24,105 +25,153 @@
 
 int UseStdOut;
 
-signed long GetLabel(char*, long, long);
+signed long GetLabel(char*, long, long, int);
+long LabelIndex(char*);
+void ResetLabels();
+#define BRANCHSITE 1      /* kinds of BranchSite, see RelaxBranches */
+#define WIDEBRANCHSITE 2
+#define SWITCHSITE 3
+void AddBranchSite(long, int, int);
+void EndBranchSite();
+void RelaxBranches();
+void ComputeFrameSize();
+int FindLabel(char*);
+int NewLabel(char*);
 
-OpCodeTranslator OpCodeArray[202];
-int OpCodeArrayCounter;
 OpCodeTranslator ConstTypeArray[12];
 int ConstTypeArrayCounter;
 /* char Code[1000]; */
 /* int CodeCounter; */
-ConstPoolEntry ConstPool[1000];
+ConstPoolEntry* ConstPool;
+int ConstPoolSize; /*number of entries allocated for ConstPool*/
 int ConstPoolArrayIndex; /*current Const Pool array number*/
 int ConstPoolIndex; /*current Const Pool index number (as Java VM thinks it is)*/
-int ConstPoolRealIndex[1000];  /* this holds the "real" index into the 
+int ConstPoolRealIndexSize;
+int* ConstPoolRealIndex;  /* this holds the "real" index into the 
 				constant pool.  The indexes in the
 				ConstPoolEntry type are really indexes into
 				this array which holds the "true" index, in
 				case we want to implement priority */
+int ConstPoolSlotSize;
+int* ConstPoolSlot;  /* the ConstPool array slot of each Java VM index, so
+			that code operands can be looked up again */
 thisclassstruct ThisClass;
 short SuperClass;
-FieldInfo field[50];
-short FieldCount;
-methodname * methodnameshead;
+FieldInfo* field;
+int FieldSize;
+int FieldCount;
+ByteBuffer MethodsBuffer;  /* each method is dumped here by EndMethod, and
+			      EndAssembler copies the lot after the fields */
 MethodInfo currentmethod;
 /*MethodInfo method[10];*/
-short MethodCount;
+int MethodCount;
+
+/* The constant pool and field tables above, and the code and local
+   variable tables of currentmethod, start out empty; GrowTable doubles them
+   as the class being assembled needs more room, up to the counts that the
+   class file format can record. */
+#define MAXCONSTPOOL 65535  /* constant_pool_count is a u2 */
+#define MAXCOUNT 65535      /* fields, methods, interfaces, locals, ... */
+#define MAXCODE 65535       /* code_length must be less than 65536 */
+
+void* GrowTable(void* table, int* size, int needed, int elemsize)
+{
+  int newsize;
+  if (needed <= *size) return table;
+  newsize = (*size > 0) ? *size : 16;
+  while (newsize < needed) newsize *= 2;
+  table = realloc(table, (size_t) newsize * elemsize);
+  if (table == NULL) oops("Out of memory");
+  *size = newsize;
+  return table;
+}
 
 char* GetLocalVarSigFromSlot(int);
 
 void copyshort2char(char* myarrayptr, short int myint)
 {
-  // memcpy(myarrayptr,&myint,2);
-  int c = 0;
-  myarrayptr[c++] = (char) (myint >> 8);
-  myarrayptr[c++] = (char) myint & 0xFF;
+  myarrayptr[0] = (char) (myint >> 8);
+  myarrayptr[1] = (char) (myint & 0xFF);
 }
 
+void copylong2char(char* myarrayptr, long myint)
+{
+  myarrayptr[0] = (char) (myint >> 24);
+  myarrayptr[1] = (char) ((myint >> 16) & 0xFF);
+  myarrayptr[2] = (char) ((myint >> 8) & 0xFF);
+  myarrayptr[3] = (char) (myint & 0xFF);
+}
 
-void outshort2char(short int myint, FILE* myoutfp)
+/* the reverse of the above, for reading back code already generated */
+short copychar2short(const char* myarrayptr)
 {
-  // fwrite(&myint,2,1,myoutfp);
-  fputc(myint >> 8, myoutfp);
-  fputc(myint & 0xFF, myoutfp);
+  return (short) (((unsigned char) myarrayptr[0] << 8) |
+		  (unsigned char) myarrayptr[1]);
 }
 
-void copylong2char(char* myarrayptr, long myint)
+long copychar2long(const char* myarrayptr)
+{
+  return (long) (int) (((unsigned long) (unsigned char) myarrayptr[0] << 24) |
+		       ((unsigned char) myarrayptr[1] << 16) |
+		       ((unsigned char) myarrayptr[2] << 8) |
+		       (unsigned char) myarrayptr[3]);
+}
+
+/* The class file is built up in a ByteBuffer and written out in one go by
+EndAssembler.  The out routines below append a value to a buffer in the
+big-endian order the class file uses.
+*/
+void ReserveBytes(ByteBuffer* mybuf, int count)
+{
+  mybuf->bytes = (char*) GrowTable(mybuf->bytes, &mybuf->size,
+                                   mybuf->length + count, 1);
+}
+
+void outchar(int mychar, ByteBuffer* mybuf)
+{
+  ReserveBytes(mybuf, 1);
+  mybuf->bytes[mybuf->length++] = (char) mychar;
+}
+
+void outbytes(const char* mybytes, int count, ByteBuffer* mybuf)
+{
+  ReserveBytes(mybuf, count);
+  memcpy(&mybuf->bytes[mybuf->length], mybytes, count);
+  mybuf->length += count;
+}
+
+void outshort2char(short int myint, ByteBuffer* mybuf)
 {
-  // memcpy(myarrayptr,&myint,4);
-  int c = 0;
-  myarrayptr[c++] = (char) myint >> 24;
-  myarrayptr[c++] = (char) (myint & 0xFFFFFF) >> 16;
-  myarrayptr[c++] = (char) (myint & 0xFFFF) >> 8;
-  myarrayptr[c++] = (char) myint & 0xFF;
+  ReserveBytes(mybuf, 2);
+  copyshort2char(&mybuf->bytes[mybuf->length], myint);
+  mybuf->length += 2;
 }
 
-void outlong2char(long myint, FILE* myoutfp)
+void outlong2char(long myint, ByteBuffer* mybuf)
 {
-  // fwrite(&myint,4,1,myoutfp);
-  fputc(myint >> 24, myoutfp);
-  fputc((myint & 0xFFFFFF) >> 16, myoutfp);
-  fputc((myint & 0xFFFF) >> 8, myoutfp);
-  fputc(myint & 0xFF, myoutfp);
+  ReserveBytes(mybuf, 4);
+  copylong2char(&mybuf->bytes[mybuf->length], myint);
+  mybuf->length += 4;
 }
 
-void outfloat2char(float myfloat, FILE* myoutfp)
+void outfloat2char(float myfloat, ByteBuffer* mybuf)
 {
-  // fwrite(&myfloat,4,1,myoutfp);
   int myint;
   memcpy(&myint, &myfloat, 4);
-  fputc(myint >> 24, myoutfp);
-  fputc((myint & 0xFFFFFF) >> 16, myoutfp);
-  fputc((myint & 0xFFFF) >> 8, myoutfp);
-  fputc(myint & 0xFF, myoutfp);
+  outlong2char(myint, mybuf);
 }
 
-void outlonglong2char(long long int mylong, FILE* myoutfp)
+void outlonglong2char(long long int mylong, ByteBuffer* mybuf)
 {
-  // fwrite(&mylong,8,1,myoutfp);
-  fputc(mylong >> 56, myoutfp);
-  fputc((mylong & 0xFFFFFFFFFFFFFF) >> 48, myoutfp);
-  fputc((mylong & 0xFFFFFFFFFFFF) >> 40, myoutfp);
-  fputc((mylong & 0xFFFFFFFFFF) >> 32, myoutfp);
-  fputc((mylong & 0xFFFFFFFF) >> 24, myoutfp);
-  fputc((mylong & 0xFFFFFF) >> 16, myoutfp);
-  fputc((mylong & 0xFFFF) >> 8, myoutfp);
-  fputc(mylong & 0xFF, myoutfp);
+  outlong2char((long) (mylong >> 32), mybuf);
+  outlong2char((long) (mylong & 0xFFFFFFFF), mybuf);
 }
 
-void outdouble2char(double mydouble, FILE* myoutfp)
+void outdouble2char(double mydouble, ByteBuffer* mybuf)
 {
-  // fwrite(&mydouble,8,1,myoutfp);
-  long long int  mylong;
+  long long int mylong;
   memcpy(&mylong, &mydouble, 8);
-  fputc(mylong >> 56, myoutfp);
-  fputc((mylong & 0xFFFFFFFFFFFFFF) >> 48, myoutfp);
-  fputc((mylong & 0xFFFFFFFFFFFF) >> 40, myoutfp);
-  fputc((mylong & 0xFFFFFFFFFF) >> 32, myoutfp);
-  fputc((mylong & 0xFFFFFFFF) >> 24, myoutfp);
-  fputc((mylong & 0xFFFFFF) >> 16, myoutfp);
-  fputc((mylong & 0xFFFF) >> 8, myoutfp);
-  fputc(mylong & 0xFF, myoutfp);
+  outlonglong2char(mylong, mybuf);
 }
 
 /* this function simply takes the passed char and puts it in the next
@@ -130,31 +179,26 @@ void outdouble2char(double mydouble, FILE* myoutfp)
 */
 void AddToCode(char mychar)
 {
+  if (currentmethod.CodeCounter >= MAXCODE)
+    oops("Method code is longer than 65535 bytes.");
+  currentmethod.Code = (char*) GrowTable(currentmethod.Code,
+                                  &currentmethod.CodeSize,
+                                  currentmethod.CodeCounter + 1, 1);
   currentmethod.Code[currentmethod.CodeCounter++] = mychar;
 }
 
 void AddShortToCode(short myshort)
 {
-  // memcpy(&currentmethod.Code[currentmethod.CodeCounter],&myshort,2);
-  // currentmethod.CodeCounter +=2;
-  currentmethod.Code[currentmethod.CodeCounter++] = 
-	  		(char) (myshort >> 8);
-  currentmethod.Code[currentmethod.CodeCounter++] = 
-	  		(char) myshort & 0xFF;
+  AddToCode((char) (myshort >> 8));
+  AddToCode((char) (myshort & 0xFF));
 }
 
 void AddLongToCode(long mylong)
 {
-  // memcpy(&currentmethod.Code[currentmethod.CodeCounter],&mylong,4);
-  // currentmethod.CodeCounter +=4;
-  currentmethod.Code[currentmethod.CodeCounter++] = 
-	  		(char) mylong >> 24;
-  currentmethod.Code[currentmethod.CodeCounter++] =
-	  		(char)(mylong&0xFFFFFF)>>16;
-  currentmethod.Code[currentmethod.CodeCounter++] =
-	 		(char)(mylong&0xFFFF)>>8;
-  currentmethod.Code[currentmethod.CodeCounter++] = 
-	  		(char) mylong & 0xFF;
+  AddToCode((char) (mylong >> 24));
+  AddToCode((char) ((mylong >> 16) & 0xFF));
+  AddToCode((char) ((mylong >> 8) & 0xFF));
+  AddToCode((char) (mylong & 0xFF));
 }
 
 void EnterConstType(int myconsttype, char mybyteval)
@@ -177,267 +221,316 @@ char GetConstType(int myconsttype)
    else oops("Looking for non-existent constant type");
 }
  
-/* these functions return an index to the myconsttype if it's already in the 
-pool, otherwise, it returns -1
-*/ 
-short int InConstPool(char myconsttype, char* mystringval)
+/* The constant pool is indexed by a chained hash table so that the
+InConstPool lookups below do not have to scan the whole pool.
+ConstHashTable holds, for every bucket, the ConstPool array slot of the
+first entry in that bucket (0 if it is empty); the rest of the bucket is
+chained through the hashnext field of the entries.  The key of an entry
+depends on its kind: the text of a Utf8, the Utf8 index of a Class or
+String, the index pair of a NameAndType or field/method reference, and the
+bit pattern of a numeric constant.
+*/
+#define CONSTHASHINITSIZE 256
+int *ConstHashTable;
+int ConstHashSize;
+
+unsigned long HashBytes(unsigned long hash, const void* data, int len)
 {
-  int i;
-  int temp;
-  //message("In InConstPool");
-  switch(myconsttype) {
-    case CONSTANT_Utf8:
-    {
-      i = 1;
-      while (i < ConstPoolArrayIndex) 
-      {
-        if ((myconsttype == ConstPool[i].consttype) &&
-            (strcmp(mystringval, ConstPool[i].stringval) == 0)) 
-          return ConstPool[i].myindex;
-        else
-          i++;
-       }
-       return -1;
-       break;
-    }
-    case CONSTANT_String:
-    case CONSTANT_Class:
-    {
-      temp = InConstPool(CONSTANT_Utf8, mystringval);
-      if (temp == -1) return -1;  /* no Utf8 with that name */
-      i = 1;
-      while (i < ConstPoolArrayIndex) 
-      {
-         if ((myconsttype == ConstPool[i].consttype) &&
-             (ConstPool[i].index1 == temp)) 
-          return ConstPool[i].myindex;
-        else
-          i++;
-       }
-       return -1;
-       break;
-     }
-     default:
-     {
-       oops("InConstPool sent bad consttype");
-       break;
-     }
+  const unsigned char* bytes = (const unsigned char*) data;
+  for (int i = 0; i < len; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 16777619UL;  /* FNV-1a */
   }
+  return hash;
 }
 
-short int InConstPool(char myconsttype, char* mystringval1, char* mystringval2)
+unsigned long ConstHash(ConstPoolEntry* entry)
 {
-  int i;
-  int temp1;
-  int temp2;
-  //message("In InConstPool");
-  switch(myconsttype) {
+  unsigned long hash = 2166136261UL;
+  hash = HashBytes(hash, &entry->consttype, sizeof(entry->consttype));
+  switch(entry->consttype) {
+    case CONSTANT_Utf8:
+      return HashBytes(hash, entry->stringval, strlen(entry->stringval));
+    case CONSTANT_String:
+    case CONSTANT_Class:
+      return HashBytes(hash, &entry->index1, sizeof(entry->index1));
     case CONSTANT_NameAndType:
-    {
-      temp1 = InConstPool(CONSTANT_Utf8, mystringval1);
-      if (temp1 == -1) return -1;  /* no Utf8 with that name */
-      temp2 = InConstPool(CONSTANT_Utf8, mystringval2);
-      if (temp2 == -1) return -1;  /* no Utf8 with that name */
-      i = 1;
-      while (i < ConstPoolArrayIndex) 
-      {
-         if ((myconsttype == ConstPool[i].consttype) &&
-             (ConstPool[i].index1 == temp1) &&
-             (ConstPool[i].index2 == temp2)) 
-          return ConstPool[i].myindex;
-        else
-          i++;
-       }
-       return -1;
-       break;
-     }
-     default:
-     {
-       oops("InConstPool sent bad consttype");
-       break;
-     }
+    case CONSTANT_Fieldref:
+    case CONSTANT_Methodref:
+    case CONSTANT_InterfaceMethodref:
+      hash = HashBytes(hash, &entry->index1, sizeof(entry->index1));
+      return HashBytes(hash, &entry->index2, sizeof(entry->index2));
+    case CONSTANT_Integer:
+      return HashBytes(hash, &entry->intval, sizeof(entry->intval));
+    case CONSTANT_Float:
+      return HashBytes(hash, &entry->floatval, sizeof(entry->floatval));
+    case CONSTANT_Long:
+      return HashBytes(hash, &entry->longval, sizeof(entry->longval));
+    case CONSTANT_Double:
+      return HashBytes(hash, &entry->doubleval, sizeof(entry->doubleval));
+    default:
+      oops("ConstHash sent bad consttype");
   }
+  return hash;
 }
 
-short int InConstPool(char myconsttype, char* mystringval1, char* mystringval2,
-		      char* mystringval3)
+int SameConst(ConstPoolEntry* a, ConstPoolEntry* b)
 {
-  int i;
-  int temp1;
-  int temp2;
-  //message("In InConstPool");
-  switch(myconsttype) {
+  if (a->consttype != b->consttype) return 0;
+  switch(a->consttype) {
+    case CONSTANT_Utf8:
+      return strcmp(a->stringval, b->stringval) == 0;
+    case CONSTANT_String:
+    case CONSTANT_Class:
+      return a->index1 == b->index1;
+    case CONSTANT_NameAndType:
     case CONSTANT_Fieldref:
     case CONSTANT_Methodref:
     case CONSTANT_InterfaceMethodref:
-    {
-      temp1 = InConstPool(CONSTANT_Class, mystringval1);
-      if (temp1 == -1) return -1;  /* no Class with that name */
-      temp2 = InConstPool(CONSTANT_NameAndType, mystringval2, mystringval3);
-      if (temp2 == -1) return -1;  /* no NameAndType */
-      i = 1;
-      while (i < ConstPoolArrayIndex) 
-      {
-         if ((myconsttype == ConstPool[i].consttype) &&
-             (ConstPool[i].index1 == temp1) &&
-             (ConstPool[i].index2 == temp2)) 
-          return ConstPool[i].myindex;
-        else
-          i++;
-       }
-       return -1;
-       break;
-     }
-     default:
-     {
-       oops("InConstPool sent bad consttype");
-       break;
-     }
+      return (a->index1 == b->index1) && (a->index2 == b->index2);
+    case CONSTANT_Integer:
+      return a->intval == b->intval;
+    /* floating point constants match on their bit pattern, so that 0.0 and
+       -0.0 stay distinct and a NaN finds itself */
+    case CONSTANT_Float:
+      return memcmp(&a->floatval, &b->floatval, sizeof(a->floatval)) == 0;
+    case CONSTANT_Long:
+      return a->longval == b->longval;
+    case CONSTANT_Double:
+      return memcmp(&a->doubleval, &b->doubleval, sizeof(a->doubleval)) == 0;
   }
+  return 0;
 }
 
+void ConstHashLink(int arrayindex)
+{
+  int bucket;
+  bucket = ConstHash(&ConstPool[arrayindex]) & (ConstHashSize - 1);
+  ConstPool[arrayindex].hashnext = ConstHashTable[bucket];
+  ConstHashTable[bucket] = arrayindex;
+}
 
-short int InConstPool(char myconsttype, long int mylong)
+void InitConstHash()
 {
-  int i;
-  int temp1;
-  int temp2;
-  //message("In InConstPool");
-  switch(myconsttype) {
-    case CONSTANT_Integer:
+  ConstHashSize = CONSTHASHINITSIZE;
+  ConstHashTable = (int *) calloc(ConstHashSize, sizeof(int));
+  if (ConstHashTable == NULL) oops("Out of memory for the constant pool index");
+}
+
+/* adds a filled-in ConstPool entry to the index, doubling the bucket array
+   whenever the pool outgrows it.  The old chains are walked to relink the
+   entries, since an entry whose operands are still being generated is not
+   in the index yet. */
+void ConstHashInsert(int arrayindex)
+{
+  int* oldtable;
+  int oldsize;
+  int next;
+  if (ConstPoolArrayIndex >= ConstHashSize / 2)
+  {
+    oldtable = ConstHashTable;
+    oldsize = ConstHashSize;
+    ConstHashSize *= 2;
+    ConstHashTable = (int *) calloc(ConstHashSize, sizeof(int));
+    if (ConstHashTable == NULL) oops("Out of memory for the constant pool index");
+    for (int j = 0; j < oldsize; j++)
     {
-      i = 0;
-      while (i < ConstPoolArrayIndex) 
+      for (int i = oldtable[j]; i != 0; i = next)
       {
-         if ((myconsttype == ConstPool[i].consttype) &&
-             (ConstPool[i].intval == mylong)) 
-          return ConstPool[i].myindex;
-        else
-          i++;
-       }
-       return -1;
-       break;
-    }
-    default:
-    {
-       oops("InConstPool sent bad consttype");
-       break;
+        next = ConstPool[i].hashnext;
+        ConstHashLink(i);
+      }
     }
+    free(oldtable);
   }
+  ConstHashLink(arrayindex);
 }
 
-short int InConstPool(char myconsttype, float myfloat)
+/* returns the index of the entry matching key's kind and value, or -1 */
+int LookupConst(ConstPoolEntry* key)
 {
   int i;
-  int temp1;
-  int temp2;
+  i = ConstHashTable[ConstHash(key) & (ConstHashSize - 1)];
+  while (i != 0)
+  {
+    if (SameConst(key, &ConstPool[i])) return ConstPool[i].myindex;
+    i = ConstPool[i].hashnext;
+  }
+  return -1;
+}
+
+/* these functions return an index to the myconsttype if it's already in the 
+pool, otherwise, it returns -1
+*/ 
+int InConstPool(char myconsttype, char* mystringval)
+{
+  ConstPoolEntry key;
   //message("In InConstPool");
+  key.consttype = myconsttype;
   switch(myconsttype) {
-    case CONSTANT_Float:
+    case CONSTANT_Utf8:
     {
-      i = 0;
-      while (i < ConstPoolArrayIndex) 
-      {
-         if ((myconsttype == ConstPool[i].consttype) &&
-             (ConstPool[i].floatval == myfloat)) 
-          return ConstPool[i].myindex;
-        else
-          i++;
-       }
-       return -1;
-       break;
+      key.stringval = mystringval;
+      return LookupConst(&key);
+    }
+    case CONSTANT_String:
+    case CONSTANT_Class:
+    {
+      key.index1 = InConstPool(CONSTANT_Utf8, mystringval);
+      if (key.index1 == -1) return -1;  /* no Utf8 with that name */
+      return LookupConst(&key);
     }
     default:
     {
-       oops("InConstPool sent bad consttype");
-       break;
+      oops("InConstPool sent bad consttype");
+      break;
     }
   }
+  return -1;
 }
 
-
-short int InConstPool(char myconsttype, long long int mylong)
+int InConstPool(char myconsttype, char* mystringval1, char* mystringval2)
 {
-  int i;
-  int temp1;
-  int temp2;
+  ConstPoolEntry key;
   //message("In InConstPool");
+  key.consttype = myconsttype;
   switch(myconsttype) {
-    case CONSTANT_Long:
+    case CONSTANT_NameAndType:
     {
-      i = 0;
-      while (i < ConstPoolArrayIndex) 
-      {
-         if ((myconsttype == ConstPool[i].consttype) &&
-             (ConstPool[i].longval == mylong)) 
-          return ConstPool[i].myindex;
-        else
-          i++;
-       }
-       return -1;
-       break;
+      key.index1 = InConstPool(CONSTANT_Utf8, mystringval1);
+      if (key.index1 == -1) return -1;  /* no Utf8 with that name */
+      key.index2 = InConstPool(CONSTANT_Utf8, mystringval2);
+      if (key.index2 == -1) return -1;  /* no Utf8 with that name */
+      return LookupConst(&key);
     }
     default:
     {
-       oops("InConstPool sent bad consttype");
-       break;
+      oops("InConstPool sent bad consttype");
+      break;
     }
   }
+  return -1;
 }
 
-short int InConstPool(char myconsttype, double mydouble)
+int InConstPool(char myconsttype, char* mystringval1, char* mystringval2,
+		      char* mystringval3)
 {
-  int i;
-  int temp1;
-  int temp2;
+  ConstPoolEntry key;
   //message("In InConstPool");
+  key.consttype = myconsttype;
   switch(myconsttype) {
-    case CONSTANT_Double:
+    case CONSTANT_Fieldref:
+    case CONSTANT_Methodref:
+    case CONSTANT_InterfaceMethodref:
     {
-      i = 0;
-      while (i < ConstPoolArrayIndex) 
-      {
-         if ((myconsttype == ConstPool[i].consttype) &&
-             (ConstPool[i].doubleval == mydouble))  
-          return ConstPool[i].myindex;
-        else
-          i++;
-       }
-       return -1;
-       break;
+      key.index1 = InConstPool(CONSTANT_Class, mystringval1);
+      if (key.index1 == -1) return -1;  /* no Class with that name */
+      key.index2 = InConstPool(CONSTANT_NameAndType, mystringval2, mystringval3);
+      if (key.index2 == -1) return -1;  /* no NameAndType */
+      return LookupConst(&key);
     }
     default:
     {
-       oops("InConstPool sent bad consttype");
-       break;
+      oops("InConstPool sent bad consttype");
+      break;
     }
   }
+  return -1;
+}
+
+
+int InConstPool(char myconsttype, long int mylong)
+{
+  ConstPoolEntry key;
+  //message("In InConstPool");
+  if (myconsttype != CONSTANT_Integer) oops("InConstPool sent bad consttype");
+  key.consttype = myconsttype;
+  key.intval = mylong;
+  return LookupConst(&key);
+}
+
+int InConstPool(char myconsttype, float myfloat)
+{
+  ConstPoolEntry key;
+  //message("In InConstPool");
+  if (myconsttype != CONSTANT_Float) oops("InConstPool sent bad consttype");
+  key.consttype = myconsttype;
+  key.floatval = myfloat;
+  return LookupConst(&key);
+}
+
+
+int InConstPool(char myconsttype, long long int mylong)
+{
+  ConstPoolEntry key;
+  //message("In InConstPool");
+  if (myconsttype != CONSTANT_Long) oops("InConstPool sent bad consttype");
+  key.consttype = myconsttype;
+  key.longval = mylong;
+  return LookupConst(&key);
+}
+
+int InConstPool(char myconsttype, double mydouble)
+{
+  ConstPoolEntry key;
+  //message("In InConstPool");
+  if (myconsttype != CONSTANT_Double) oops("InConstPool sent bad consttype");
+  key.consttype = myconsttype;
+  key.doubleval = mydouble;
+  return LookupConst(&key);
 }
 
 
 
 
+/* takes the next ConstPool array slot for a new entry that uses width
+Java VM indexes (2 for longs and doubles, 1 for everything else), and returns
+that slot with its myindex filled in.
+*/
+int NewConstSlot(int width)
+{
+  int touse;
+  if (ConstPoolIndex + width > MAXCONSTPOOL)
+    oops("Constant pool is full (the class file limit is 65535 entries).");
+  ConstPool = (ConstPoolEntry*) GrowTable(ConstPool, &ConstPoolSize,
+                                  ConstPoolArrayIndex + 1, sizeof(ConstPoolEntry));
+  ConstPoolRealIndex = (int*) GrowTable(ConstPoolRealIndex,
+                                  &ConstPoolRealIndexSize,
+                                  ConstPoolIndex + width, sizeof(int));
+  ConstPoolSlot = (int*) GrowTable(ConstPoolSlot, &ConstPoolSlotSize,
+                                  ConstPoolIndex + width, sizeof(int));
+  for (int i = ConstPoolIndex; i < ConstPoolIndex + width; i++)
+  {
+    ConstPoolRealIndex[i] = i;
+    ConstPoolSlot[i] = ConstPoolArrayIndex;
+  }
+  touse = ConstPoolArrayIndex;
+  ConstPool[touse].myindex = ConstPoolIndex;
+  ConstPoolArrayIndex++;
+  ConstPoolIndex += width;
+  return touse;
+}
+
 /* These routines generate a constant pool entry according to the 
 specified paramenters.  If the requested entry already exists, it just
 returns the index to that entry.
 */
-short GenConst(char myconsttype, char* mystringval)
+int GenConst(char myconsttype, char* mystringval)
 {
-  short int checkresult;
-  short int toreturn;
-  short int touse;
+  int checkresult;
+  int touse;
+  int index1;
   //message("In GenConst");
   checkresult = InConstPool(myconsttype, mystringval);
   if (checkresult >= 0) return checkresult;
-  toreturn = ConstPoolIndex;
-  touse = ConstPoolArrayIndex;
-  ConstPoolArrayIndex++;
-  ConstPoolIndex++;
+  touse = NewConstSlot(1);
   ConstPool[touse].consttype = myconsttype;
-  ConstPool[touse].myindex = toreturn;
   switch(myconsttype) {
     case CONSTANT_Utf8:
     {
+      if (strlen(mystringval) > MAXCOUNT)
+        oops("String constant is longer than 65535 bytes.");
       ConstPool[touse].stringval = (char *) malloc(strlen(mystringval)+1);
       strcpy(ConstPool[touse].stringval, mystringval);
       break;
@@ -445,7 +538,10 @@ short GenConst(char myconsttype, char* mystringval)
     case CONSTANT_String:
     case CONSTANT_Class:
     {
-      ConstPool[touse].index1 = GenConst(CONSTANT_Utf8,mystringval);
+      /* the nested GenConst may move ConstPool, so don't hold on to
+         the entry across the call */
+      index1 = GenConst(CONSTANT_Utf8,mystringval);
+      ConstPool[touse].index1 = index1;
       break;
     }
     default:
@@ -454,29 +550,28 @@ short GenConst(char myconsttype, char* mystringval)
       break;
     }
   }
-  return toreturn;
+  ConstHashInsert(touse);
+  return ConstPool[touse].myindex;
 }
 
 
-short GenConst(char myconsttype, char* mystringval1, char* mystringval2)
+int GenConst(char myconsttype, char* mystringval1, char* mystringval2)
 {
-  short int checkresult;
-  short int toreturn;
-  short int touse;
+  int checkresult;
+  int touse;
+  int index1, index2;
   //message("In GenConst");
   checkresult = InConstPool(myconsttype, mystringval1, mystringval2);
   if (checkresult >= 0) return checkresult;
-  toreturn = ConstPoolIndex;
-  touse = ConstPoolArrayIndex;
-  ConstPoolIndex++;
-  ConstPoolArrayIndex++;
+  touse = NewConstSlot(1);
   ConstPool[touse].consttype = myconsttype;
-  ConstPool[touse].myindex = toreturn;
   switch(myconsttype) {
     case CONSTANT_NameAndType:
     {
-      ConstPool[touse].index1 = GenConst(CONSTANT_Utf8,mystringval1);
-      ConstPool[touse].index2 = GenConst(CONSTANT_Utf8,mystringval2);
+      index1 = GenConst(CONSTANT_Utf8,mystringval1);
+      index2 = GenConst(CONSTANT_Utf8,mystringval2);
+      ConstPool[touse].index1 = index1;
+      ConstPool[touse].index2 = index2;
       break;
     }
     default:
@@ -485,34 +580,32 @@ short GenConst(char myconsttype, char* mystringval1, char* mystringval2)
       break;
     }
   }
-  return toreturn;
+  ConstHashInsert(touse);
+  return ConstPool[touse].myindex;
 }
 
 
-short GenConst(char myconsttype, char* mystringval1, char* mystringval2,
+int GenConst(char myconsttype, char* mystringval1, char* mystringval2,
 	       char* mystringval3)
 {
-  short int checkresult;
-  short int toreturn;
-  short int touse;
+  int checkresult;
+  int touse;
+  int index1, index2;
   //message("In GenConst");
   checkresult = InConstPool(myconsttype, mystringval1, mystringval2, 
 			    mystringval3);
   if (checkresult >= 0) return checkresult;
-  toreturn = ConstPoolIndex;
-  touse = ConstPoolArrayIndex;
-  ConstPoolIndex++;
-  ConstPoolArrayIndex++;
+  touse = NewConstSlot(1);
   ConstPool[touse].consttype = myconsttype;
-  ConstPool[touse].myindex = toreturn;
   switch(myconsttype) {
     case CONSTANT_Fieldref:
     case CONSTANT_Methodref:
     case CONSTANT_InterfaceMethodref:
     {
-      ConstPool[touse].index1 = GenConst(CONSTANT_Class,mystringval1);
-      ConstPool[touse].index2 = GenConst(CONSTANT_NameAndType,
-					    mystringval2, mystringval3);
+      index1 = GenConst(CONSTANT_Class,mystringval1);
+      index2 = GenConst(CONSTANT_NameAndType, mystringval2, mystringval3);
+      ConstPool[touse].index1 = index1;
+      ConstPool[touse].index2 = index2;
       break;
     }
     default:
@@ -521,24 +614,20 @@ short GenConst(char myconsttype, char* mystringval1, char* mystringval2,
       break;
     }
   }
-  return toreturn;
+  ConstHashInsert(touse);
+  return ConstPool[touse].myindex;
 }
 
 
-short GenConst(char myconsttype, long int mylong)
+int GenConst(char myconsttype, long int mylong)
 {
-  short int checkresult;
-  short int toreturn;
-  short int touse;
+  int checkresult;
+  int touse;
   //message("In GenConst");
   checkresult = InConstPool(myconsttype, mylong); 
   if (checkresult >= 0) return checkresult;
-  toreturn = ConstPoolIndex;
-  touse = ConstPoolArrayIndex;
-  ConstPoolIndex++;
-  ConstPoolArrayIndex++;
+  touse = NewConstSlot(1);
   ConstPool[touse].consttype = myconsttype;
-  ConstPool[touse].myindex = toreturn;
   switch(myconsttype) {
     case CONSTANT_Integer:
     {
@@ -551,24 +640,20 @@ short GenConst(char myconsttype, long int mylong)
       break;
     }
   }
-  return toreturn;
+  ConstHashInsert(touse);
+  return ConstPool[touse].myindex;
 }
 
 
-short GenConst(char myconsttype, float myfloat)
+int GenConst(char myconsttype, float myfloat)
 {
-  short int checkresult;
-  short int toreturn;
-  short int touse;
+  int checkresult;
+  int touse;
   //message("In GenConst");
   checkresult = InConstPool(myconsttype, myfloat); 
   if (checkresult >= 0) return checkresult;
-  toreturn = ConstPoolIndex;
-  touse = ConstPoolArrayIndex;
-  ConstPoolIndex++;
-  ConstPoolArrayIndex++;
+  touse = NewConstSlot(1);
   ConstPool[touse].consttype = myconsttype;
-  ConstPool[touse].myindex = toreturn;
   switch(myconsttype) {
     case CONSTANT_Float:
     {
@@ -581,29 +666,24 @@ short GenConst(char myconsttype, float myfloat)
       break;
     }
   }
-  return toreturn;
+  ConstHashInsert(touse);
+  return ConstPool[touse].myindex;
 }
 
 
-short GenConst(char myconsttype, long long int mylong)
+int GenConst(char myconsttype, long long int mylong)
 {
-  short int checkresult;
-  short int toreturn;
-  short int touse;
+  int checkresult;
+  int touse;
   //message("In GenConst");
   checkresult = InConstPool(myconsttype, mylong); 
   if (checkresult >= 0) return checkresult;
-  toreturn = ConstPoolIndex;
-  touse = ConstPoolArrayIndex;
-  ConstPoolIndex++;
-  ConstPoolIndex++;
-  ConstPoolArrayIndex++;
+  touse = NewConstSlot(2);
   ConstPool[touse].consttype = myconsttype;
-  ConstPool[touse].myindex = toreturn;
   switch(myconsttype) {
     case CONSTANT_Long:
     {
-      ConstPool[toreturn].longval = mylong; 
+      ConstPool[touse].longval = mylong; 
       break;
     }
     default:
@@ -612,25 +692,20 @@ short GenConst(char myconsttype, long long int mylong)
       break;
     }
   }
-  return toreturn;
+  ConstHashInsert(touse);
+  return ConstPool[touse].myindex;
 }
 
 
-short GenConst(char myconsttype, double mydouble)
+int GenConst(char myconsttype, double mydouble)
 {
-  short int checkresult;
-  short int toreturn;
-  short int touse;
+  int checkresult;
+  int touse;
   //message("In GenConst");
   checkresult = InConstPool(myconsttype,mydouble); 
   if (checkresult >= 0) return checkresult;
-  toreturn = ConstPoolIndex;
-  touse = ConstPoolArrayIndex;
-  ConstPoolIndex++;
-  ConstPoolIndex++;
-  ConstPoolArrayIndex++;
+  touse = NewConstSlot(2);
   ConstPool[touse].consttype = myconsttype;
-  ConstPool[touse].myindex = toreturn;
   switch(myconsttype) {
     case CONSTANT_Double:
     {
@@ -643,24 +718,229 @@ short GenConst(char myconsttype, double mydouble)
       break;
     }
   }
-  return toreturn;
-}
-
-
-
-
-void EnterOpCode(int myopcode, char mybyteval)
-{
-   OpCodeArray[OpCodeArrayCounter].opcode = myopcode;
-   OpCodeArray[OpCodeArrayCounter].byteval = mybyteval;
-   OpCodeArrayCounter++;
+  ConstHashInsert(touse);
+  return ConstPool[touse].myindex;
+}
+
+
+
+
+/* maps an instruction token from the grammar to its JVM opcode, whose
+   details are then in JvmOpTable (see opcode_table.h) */
+int TokenOpCode(int mytoken)
+{
+   switch (mytoken) {
+     case NOP: return OP_NOP;
+     case ACONST_NULL: return OP_ACONST_NULL;
+     case ICONST_M1: return OP_ICONST_M1;
+     case ICONST_0: return OP_ICONST_0;
+     case ICONST_1: return OP_ICONST_1;
+     case ICONST_2: return OP_ICONST_2;
+     case ICONST_3: return OP_ICONST_3;
+     case ICONST_4: return OP_ICONST_4;
+     case ICONST_5: return OP_ICONST_5;
+     case LCONST_0: return OP_LCONST_0;
+     case LCONST_1: return OP_LCONST_1;
+     case FCONST_0: return OP_FCONST_0;
+     case FCONST_1: return OP_FCONST_1;
+     case FCONST_2: return OP_FCONST_2;
+     case DCONST_0: return OP_DCONST_0;
+     case DCONST_1: return OP_DCONST_1;
+     case BIPUSH: return OP_BIPUSH;
+     case SIPUSH: return OP_SIPUSH;
+     case LDC: return OP_LDC;
+     case LDC_W: return OP_LDC_W;
+     case LDC2_W: return OP_LDC2_W;
+     case ILOAD: return OP_ILOAD;
+     case LLOAD: return OP_LLOAD;
+     case FLOAD: return OP_FLOAD;
+     case DLOAD: return OP_DLOAD;
+     case ALOAD: return OP_ALOAD;
+     case ILOAD_0: return OP_ILOAD_0;
+     case ILOAD_1: return OP_ILOAD_1;
+     case ILOAD_2: return OP_ILOAD_2;
+     case ILOAD_3: return OP_ILOAD_3;
+     case LLOAD_0: return OP_LLOAD_0;
+     case LLOAD_1: return OP_LLOAD_1;
+     case LLOAD_2: return OP_LLOAD_2;
+     case LLOAD_3: return OP_LLOAD_3;
+     case FLOAD_0: return OP_FLOAD_0;
+     case FLOAD_1: return OP_FLOAD_1;
+     case FLOAD_2: return OP_FLOAD_2;
+     case FLOAD_3: return OP_FLOAD_3;
+     case DLOAD_0: return OP_DLOAD_0;
+     case DLOAD_1: return OP_DLOAD_1;
+     case DLOAD_2: return OP_DLOAD_2;
+     case DLOAD_3: return OP_DLOAD_3;
+     case ALOAD_0: return OP_ALOAD_0;
+     case ALOAD_1: return OP_ALOAD_1;
+     case ALOAD_2: return OP_ALOAD_2;
+     case ALOAD_3: return OP_ALOAD_3;
+     case IALOAD: return OP_IALOAD;
+     case LALOAD: return OP_LALOAD;
+     case FALOAD: return OP_FALOAD;
+     case DALOAD: return OP_DALOAD;
+     case AALOAD: return OP_AALOAD;
+     case BALOAD: return OP_BALOAD;
+     case CALOAD: return OP_CALOAD;
+     case SALOAD: return OP_SALOAD;
+     case ISTORE: return OP_ISTORE;
+     case LSTORE: return OP_LSTORE;
+     case FSTORE: return OP_FSTORE;
+     case DSTORE: return OP_DSTORE;
+     case ASTORE: return OP_ASTORE;
+     case ISTORE_0: return OP_ISTORE_0;
+     case ISTORE_1: return OP_ISTORE_1;
+     case ISTORE_2: return OP_ISTORE_2;
+     case ISTORE_3: return OP_ISTORE_3;
+     case LSTORE_0: return OP_LSTORE_0;
+     case LSTORE_1: return OP_LSTORE_1;
+     case LSTORE_2: return OP_LSTORE_2;
+     case LSTORE_3: return OP_LSTORE_3;
+     case FSTORE_0: return OP_FSTORE_0;
+     case FSTORE_1: return OP_FSTORE_1;
+     case FSTORE_2: return OP_FSTORE_2;
+     case FSTORE_3: return OP_FSTORE_3;
+     case DSTORE_0: return OP_DSTORE_0;
+     case DSTORE_1: return OP_DSTORE_1;
+     case DSTORE_2: return OP_DSTORE_2;
+     case DSTORE_3: return OP_DSTORE_3;
+     case ASTORE_0: return OP_ASTORE_0;
+     case ASTORE_1: return OP_ASTORE_1;
+     case ASTORE_2: return OP_ASTORE_2;
+     case ASTORE_3: return OP_ASTORE_3;
+     case IASTORE: return OP_IASTORE;
+     case LASTORE: return OP_LASTORE;
+     case FASTORE: return OP_FASTORE;
+     case DASTORE: return OP_DASTORE;
+     case AASTORE: return OP_AASTORE;
+     case BASTORE: return OP_BASTORE;
+     case CASTORE: return OP_CASTORE;
+     case SASTORE: return OP_SASTORE;
+     case POP: return OP_POP;
+     case POP2: return OP_POP2;
+     case DUP: return OP_DUP;
+     case DUP_X1: return OP_DUP_X1;
+     case DUP_X2: return OP_DUP_X2;
+     case DUP2: return OP_DUP2;
+     case DUP2_X1: return OP_DUP2_X1;
+     case DUP2_X2: return OP_DUP2_X2;
+     case SWAP: return OP_SWAP;
+     case IADD: return OP_IADD;
+     case LADD: return OP_LADD;
+     case FADD: return OP_FADD;
+     case DADD: return OP_DADD;
+     case ISUB: return OP_ISUB;
+     case LSUB: return OP_LSUB;
+     case FSUB: return OP_FSUB;
+     case DSUB: return OP_DSUB;
+     case IMUL: return OP_IMUL;
+     case LMUL: return OP_LMUL;
+     case FMUL: return OP_FMUL;
+     case DMUL: return OP_DMUL;
+     case IDIV: return OP_IDIV;
+     case LDIV: return OP_LDIV;
+     case FDIV: return OP_FDIV;
+     case DDIV: return OP_DDIV;
+     case IREM: return OP_IREM;
+     case LREM: return OP_LREM;
+     case FREM: return OP_FREM;
+     case DREM: return OP_DREM;
+     case INEG: return OP_INEG;
+     case LNEG: return OP_LNEG;
+     case FNEG: return OP_FNEG;
+     case DNEG: return OP_DNEG;
+     case ISHL: return OP_ISHL;
+     case LSHL: return OP_LSHL;
+     case ISHR: return OP_ISHR;
+     case LSHR: return OP_LSHR;
+     case IUSHR: return OP_IUSHR;
+     case LUSHR: return OP_LUSHR;
+     case IAND: return OP_IAND;
+     case LAND: return OP_LAND;
+     case IOR: return OP_IOR;
+     case LOR: return OP_LOR;
+     case IXOR: return OP_IXOR;
+     case LXOR: return OP_LXOR;
+     case IINC: return OP_IINC;
+     case I2L: return OP_I2L;
+     case I2F: return OP_I2F;
+     case I2D: return OP_I2D;
+     case L2I: return OP_L2I;
+     case L2F: return OP_L2F;
+     case L2D: return OP_L2D;
+     case F2I: return OP_F2I;
+     case F2L: return OP_F2L;
+     case F2D: return OP_F2D;
+     case D2I: return OP_D2I;
+     case D2L: return OP_D2L;
+     case D2F: return OP_D2F;
+     case I2B: return OP_I2B;
+     case I2C: return OP_I2C;
+     case I2S: return OP_I2S;
+     case LCMP: return OP_LCMP;
+     case FCMPL: return OP_FCMPL;
+     case FCMPG: return OP_FCMPG;
+     case DCMPL: return OP_DCMPL;
+     case DCMPG: return OP_DCMPG;
+     case IFEQ: return OP_IFEQ;
+     case IFNE: return OP_IFNE;
+     case IFLT: return OP_IFLT;
+     case IFGE: return OP_IFGE;
+     case IFGT: return OP_IFGT;
+     case IFLE: return OP_IFLE;
+     case IF_ICMPEQ: return OP_IF_ICMPEQ;
+     case IF_ICMPNE: return OP_IF_ICMPNE;
+     case IF_ICMPLT: return OP_IF_ICMPLT;
+     case IF_ICMPGE: return OP_IF_ICMPGE;
+     case IF_ICMPGT: return OP_IF_ICMPGT;
+     case IF_ICMPLE: return OP_IF_ICMPLE;
+     case IF_ACMPEQ: return OP_IF_ACMPEQ;
+     case IF_ACMPNE: return OP_IF_ACMPNE;
+     case GOTO: return OP_GOTO;
+     case JSR: return OP_JSR;
+     case RET: return OP_RET;
+     case TABLESWITCH: return OP_TABLESWITCH;
+     case LOOKUPSWITCH: return OP_LOOKUPSWITCH;
+     case IRETURN: return OP_IRETURN;
+     case LRETURN: return OP_LRETURN;
+     case FRETURN: return OP_FRETURN;
+     case DRETURN: return OP_DRETURN;
+     case ARETURN: return OP_ARETURN;
+     case RETURN: return OP_RETURN;
+     case GETSTATIC: return OP_GETSTATIC;
+     case PUTSTATIC: return OP_PUTSTATIC;
+     case GETFIELD: return OP_GETFIELD;
+     case PUTFIELD: return OP_PUTFIELD;
+     case INVOKEVIRTUAL: return OP_INVOKEVIRTUAL;
+     case INVOKENONVIRTUAL: return OP_INVOKENONVIRTUAL;
+     case INVOKESTATIC: return OP_INVOKESTATIC;
+     case INVOKEINTERFACE: return OP_INVOKEINTERFACE;
+     case NEW: return OP_NEW;
+     case NEWARRAY: return OP_NEWARRAY;
+     case ANEWARRAY: return OP_ANEWARRAY;
+     case ARRAYLENGTH: return OP_ARRAYLENGTH;
+     case ATHROW: return OP_ATHROW;
+     case CHECKCAST: return OP_CHECKCAST;
+     case INSTANCEOF: return OP_INSTANCEOF;
+     case MONITORENTER: return OP_MONITORENTER;
+     case MONITOREXIT: return OP_MONITOREXIT;
+     case WIDE: return OP_WIDE;
+     case MULTIANEWARRAY: return OP_MULTIANEWARRAY;
+     case IFNULL: return OP_IFNULL;
+     case IFNONNULL: return OP_IFNONNULL;
+     case GOTO_W: return OP_GOTO_W;
+     case JSR_W: return OP_JSR_W;
+     default: return -1;
+   }
 }
 
 char GetOpCode(int myopcode)
 {
-   for (int j=0; j<OpCodeArrayCounter;j++)
-     if(myopcode == OpCodeArray[j].opcode) return OpCodeArray[j].byteval;
-   oops("Looking for non-existent op code");
+   int op;
+   op = TokenOpCode(myopcode);
+   if (op < 0) oops("Looking for non-existent op code");
+   return (char) JvmOpTable[op].byteval;
 }
 
 #define ACC_SUPER 0x0020
@@ -672,8 +952,6 @@ void SetThisClass(short access_flags, char* classname, char* superclassname)
   ThisClass.classname = classname;
   ThisClass.superclassindex = GenConst(CONSTANT_Class,superclassname);
   ThisClass.superclassname = superclassname;
-  ThisClass.interfacecount = 0;
-  ThisClass.interfacehead = NULL;
   ThisClass.sourcefileindex = -1;  /* it will get set later */
 }
 
@@ -698,6 +976,8 @@ void SetSourceFile(char* name)
 void AddToInterfaceList(char* name)
 {
   interfaceentry* toadd;
+  if (ThisClass.interfacecount >= MAXCOUNT)
+    oops("Too many interfaces (the class file limit is 65535).");
   toadd = (interfaceentry*) malloc(sizeof(interfaceentry));
   toadd->index = GenConst(CONSTANT_Class, name);
   toadd->next = ThisClass.interfacehead;
@@ -709,209 +989,6 @@ void AddToInterfaceList(char* name)
  
 void InitAssembler()
 {
-   OpCodeArrayCounter = 0;
-   EnterOpCode(AALOAD, 50);
-   EnterOpCode(AASTORE, 83);
-   EnterOpCode(ACONST_NULL, 1);
-   EnterOpCode(ALOAD_0, 42);
-   EnterOpCode(ALOAD_1, 43);
-   EnterOpCode(ALOAD_2, 44);
-   EnterOpCode(ALOAD_3, 45);
-   EnterOpCode(ANEWARRAY, 189);
-   EnterOpCode(ARETURN, 176);
-   EnterOpCode(ARRAYLENGTH, 190);
-   EnterOpCode(ASTORE_0, 75);
-   EnterOpCode(ASTORE_1, 76);
-   EnterOpCode(ASTORE_2, 77);
-   EnterOpCode(ASTORE_3, 78);
-   EnterOpCode(ATHROW, 191);
-   EnterOpCode(BALOAD, 51);
-   EnterOpCode(BASTORE, 84);
-   EnterOpCode(BIPUSH, 16);
-   EnterOpCode(CALOAD, 52);
-   EnterOpCode(CASTORE, 85);
-   EnterOpCode(CHECKCAST, 192);
-   EnterOpCode(D2F, 144);
-   EnterOpCode(D2I, 142);
-   EnterOpCode(D2L, 143);
-   EnterOpCode(DADD, 99);
-   EnterOpCode(DALOAD, 49);
-   EnterOpCode(DASTORE, 82);
-   EnterOpCode(DCMPG, 152);
-   EnterOpCode(DCMPL, 151);
-   EnterOpCode(DCONST_0, 14);
-   EnterOpCode(DCONST_1, 15);
-   EnterOpCode(DDIV, 111);
-   EnterOpCode(DLOAD_0, 38);
-   EnterOpCode(DLOAD_1, 39);
-   EnterOpCode(DLOAD_2, 40);
-   EnterOpCode(DLOAD_3, 41);
-   EnterOpCode(DMUL, 107);
-   EnterOpCode(DNEG, 119);
-   EnterOpCode(DREM, 115);
-   EnterOpCode(DRETURN, 175);
-   EnterOpCode(DSTORE_0, 71);
-   EnterOpCode(DSTORE_1, 72);
-   EnterOpCode(DSTORE_2, 73);
-   EnterOpCode(DSTORE_3, 74);
-   EnterOpCode(DSUB, 103);
-   EnterOpCode(DUP, 89);
-   EnterOpCode(DUP_X1, 90);
-   EnterOpCode(DUP_X2, 91);
-   EnterOpCode(DUP2, 92);
-   EnterOpCode(DUP2_X1, 93);
-   EnterOpCode(DUP2_X2, 94);
-   EnterOpCode(F2D, 141);
-   EnterOpCode(F2I, 139);
-   EnterOpCode(F2L, 140);
-   EnterOpCode(FADD, 98);
-   EnterOpCode(FALOAD, 48);
-   EnterOpCode(FASTORE, 81);
-   EnterOpCode(FCMPG, 150);
-   EnterOpCode(FCMPL, 149);
-   EnterOpCode(FCONST_0, 11);
-   EnterOpCode(FCONST_1, 12);
-   EnterOpCode(FCONST_2, 13);
-   EnterOpCode(FDIV, 110);
-   EnterOpCode(FLOAD_0, 34);
-   EnterOpCode(FLOAD_1, 35);
-   EnterOpCode(FLOAD_2, 36);
-   EnterOpCode(FLOAD_3, 37);
-   EnterOpCode(FMUL, 106);
-   EnterOpCode(FNEG, 118);
-   EnterOpCode(FREM, 114);
-   EnterOpCode(FRETURN, 174);
-   EnterOpCode(FSTORE_0, 67);
-   EnterOpCode(FSTORE_1, 68);
-   EnterOpCode(FSTORE_2, 69);
-   EnterOpCode(FSTORE_3, 70);
-   EnterOpCode(FSUB, 102);
-   EnterOpCode(GETFIELD, 180);
-   EnterOpCode(GETSTATIC, 178);
-   EnterOpCode(GOTO,167);
-   EnterOpCode(GOTO_W,200);
-   EnterOpCode(I2B,145);
-   EnterOpCode(I2C,146);
-   EnterOpCode(I2D,135);
-   EnterOpCode(I2F,134);
-   EnterOpCode(I2L,133);
-   EnterOpCode(I2S,147);
-   EnterOpCode(IADD,96);
-   EnterOpCode(IALOAD,46);
-   EnterOpCode(IAND,126);
-   EnterOpCode(IASTORE,79);
-   EnterOpCode(ICONST_0,3);
-   EnterOpCode(ICONST_1,4);
-   EnterOpCode(ICONST_2,5);
-   EnterOpCode(ICONST_3,6);
-   EnterOpCode(ICONST_4,7);
-   EnterOpCode(ICONST_5,8);
-   EnterOpCode(ICONST_M1,2);
-   EnterOpCode(IDIV,108);
-   EnterOpCode(IF_ACMPEQ,165);
-   EnterOpCode(IF_ACMPNE,166);
-   EnterOpCode(IF_ICMPEQ,159);
-   EnterOpCode(IF_ICMPNE,160);
-   EnterOpCode(IF_ICMPLT,161);
-   EnterOpCode(IF_ICMPGE,162);
-   EnterOpCode(IF_ICMPGT,163);
-   EnterOpCode(IF_ICMPLE,164);
-   EnterOpCode(IFEQ,153);
-   EnterOpCode(IFNE,154);
-   EnterOpCode(IFLT,155);
-   EnterOpCode(IFGE,156);
-   EnterOpCode(IFGT,157);
-   EnterOpCode(IFLE,158);
-   EnterOpCode(IFNONNULL,199);
-   EnterOpCode(IFNULL,198);
-   EnterOpCode(ILOAD_0,26);
-   EnterOpCode(ILOAD_1,27);
-   EnterOpCode(ILOAD_2,28);
-   EnterOpCode(ILOAD_3,29);
-   EnterOpCode(IMUL,104);
-   EnterOpCode(INEG,116);
-   EnterOpCode(IOR,128);
-   EnterOpCode(IREM,112);
-   EnterOpCode(IRETURN,172);
-   EnterOpCode(ISHL,120);
-   EnterOpCode(ISHR,122);
-   EnterOpCode(ISTORE_0,59);
-   EnterOpCode(ISTORE_1,60);
-   EnterOpCode(ISTORE_2,61);
-   EnterOpCode(ISTORE_3,62);
-   EnterOpCode(ISUB,100);
-   EnterOpCode(IUSHR,124);
-   EnterOpCode(IXOR,130);
-   EnterOpCode(JSR,168);
-   EnterOpCode(JSR_W,201);
-   EnterOpCode(L2D,138);
-   EnterOpCode(L2F,137);
-   EnterOpCode(L2I,136);
-   EnterOpCode(LADD,97);
-   EnterOpCode(LALOAD,47);
-   EnterOpCode(LAND,127);
-   EnterOpCode(LASTORE,80);
-   EnterOpCode(LCMP,148);
-   EnterOpCode(LCONST_0,9);
-   EnterOpCode(LCONST_1,10);
-   EnterOpCode(LDIV,109);
-   EnterOpCode(LLOAD_0,30);
-   EnterOpCode(LLOAD_1,31);
-   EnterOpCode(LLOAD_2,32);
-   EnterOpCode(LLOAD_3,33);
-   EnterOpCode(LMUL,105);
-   EnterOpCode(LNEG,117);
-   EnterOpCode(LOR,129);
-   EnterOpCode(LREM,113);
-   EnterOpCode(LRETURN,173);
-   EnterOpCode(LSHL,121);
-   EnterOpCode(LSHR,123);
-   EnterOpCode(LSTORE_0,63);
-   EnterOpCode(LSTORE_1,64);
-   EnterOpCode(LSTORE_2,65);
-   EnterOpCode(LSTORE_3,66);
-   EnterOpCode(LSUB,101);
-   EnterOpCode(LUSHR,125);
-   EnterOpCode(LXOR,131);
-   EnterOpCode(MONITORENTER,194);
-   EnterOpCode(MONITOREXIT,195);
-   EnterOpCode(NOP,0);
-   EnterOpCode(POP,87);
-   EnterOpCode(POP2,88);
-   EnterOpCode(RETURN,177);
-   EnterOpCode(SALOAD,53);
-   EnterOpCode(SASTORE,86);
-   EnterOpCode(SWAP,95);
-   EnterOpCode(IINC, 132);
-   EnterOpCode(INSTANCEOF, 193);
-   EnterOpCode(INVOKEINTERFACE, 185);
-   EnterOpCode(INVOKENONVIRTUAL, 183);
-   EnterOpCode(INVOKESTATIC, 184);
-   EnterOpCode(INVOKEVIRTUAL, 182);
-   EnterOpCode(LDC, 18);
-   EnterOpCode(LDC_W, 19);
-   EnterOpCode(LDC2_W, 20);
-   EnterOpCode(MULTIANEWARRAY, 197);
-   EnterOpCode(NEW, 187);
-   EnterOpCode(NEWARRAY, 188);
-   EnterOpCode(PUTFIELD, 181);
-   EnterOpCode(PUTSTATIC, 179);
-   EnterOpCode(SIPUSH, 17);
-   EnterOpCode(ILOAD, 21);
-   EnterOpCode(ALOAD, 25);
-   EnterOpCode(FLOAD, 23);
-   EnterOpCode(LLOAD, 22);
-   EnterOpCode(DLOAD, 24);
-   EnterOpCode(ISTORE, 54);
-   EnterOpCode(FSTORE, 56);
-   EnterOpCode(ASTORE, 58);
-   EnterOpCode(LSTORE, 55);
-   EnterOpCode(DSTORE, 57);
-   EnterOpCode(RET, 169);
-   EnterOpCode(WIDE, 196);
-   EnterOpCode(LOOKUPSWITCH, 171);
-   EnterOpCode(TABLESWITCH, 170);
-
    ConstTypeArrayCounter = 0;
    EnterConstType(CONSTANT_Class, 7);
    EnterConstType(CONSTANT_Fieldref, 9);
@@ -926,30 +1003,57 @@ void InitAssembler()
    EnterConstType(CONSTANT_Utf8, 1);
    ConstPoolIndex = 1;
    ConstPoolArrayIndex = 1;
-   for (int i=1;i<1000;i++) ConstPoolRealIndex[i]=i; 
+   InitConstHash();
    //message("Done with InitAssembler");
-   //printf("OpCodeArrayCounter is %i\n", OpCodeArrayCounter);
    MethodCount = 0;
    FieldCount = 0;
-   methodnameshead = NULL;
+   MethodsBuffer.length = 0;
+   /* the interfaces are parsed before SetThisClass is called, so the list
+      has to be started here */
+   ThisClass.interfacecount = 0;
+   ThisClass.interfacehead = NULL;
+}
+
+/* returns the number of bytes ConstPoolDump will write */
+long ConstPoolDumpSize()
+{
+  long size;
+  size = 2;
+  for(int i=1;i<ConstPoolArrayIndex;i++)
+  {
+    switch(ConstPool[i].consttype) {
+      case CONSTANT_Utf8:
+        size += 3 + strlen(ConstPool[i].stringval);
+        break;
+      case CONSTANT_String:
+      case CONSTANT_Class:
+        size += 3;
+        break;
+      case CONSTANT_Long:
+      case CONSTANT_Double:
+        size += 9;
+        break;
+      default:   /* the index pairs, Integer and Float */
+        size += 5;
+        break;
+    }
+  }
+  return size;
 }
 
-void ConstPoolDump(FILE* myoutfp)
+void ConstPoolDump(ByteBuffer* myoutfp)
 {
-  short int mylen;
+  int mylen;
   outshort2char(ConstPoolIndex, myoutfp);
   for(int i=1;i<ConstPoolArrayIndex;i++)
   {
-    putc(GetConstType(ConstPool[i].consttype), myoutfp);
+    outchar(GetConstType(ConstPool[i].consttype), myoutfp);
     switch(ConstPool[i].consttype) {
       case CONSTANT_Utf8:
       {
 	mylen = strlen(ConstPool[i].stringval);
         outshort2char(mylen, myoutfp);
-        for(int j=0;j<mylen;j++)
-        {
-          putc(ConstPool[i].stringval[j], myoutfp);
-        }
+        outbytes(ConstPool[i].stringval, mylen, myoutfp);
         break;
       }
       case CONSTANT_String:
@@ -997,28 +1101,8 @@ void ConstPoolDump(FILE* myoutfp)
 }
 
 
-/* very simple file copy.  Probably should use system reads and writes */
-void CopyMethod(char* aname, FILE* myoutfp)
+void MethodDump(MethodInfo mymethod, ByteBuffer* outfp)
 {
-   int mychar;
-   FILE *myinfp;
-   if ((myinfp = fopen(aname, "r")) == 0)
-     oops("Couldn't open method file for copying");
-   mychar = fgetc(myinfp);
-   while(mychar != EOF)
-   {
-     fputc(mychar,myoutfp);
-     mychar = fgetc(myinfp);
-   }
-   fclose(myinfp);
-}
-      
-  
-
-void MethodDump(MethodInfo mymethod, FILE* outfp)
-{
-  int i;
-  int lastlocal;
   int codeattlen;
   short additionalattrib; 
   short additionalcodeattrib; 
@@ -1087,12 +1171,7 @@ void MethodDump(MethodInfo mymethod, FILE* outfp)
     }
     outlong2char(mymethod.CodeCounter,outfp);
     //outshort2char(mymethod.CodeCounter,outfp);
-    i = 0;
-    while (i < mymethod.CodeCounter)
-    {
-      putc(mymethod.Code[i],outfp);
-      i++;
-    }
+    outbytes(mymethod.Code, mymethod.CodeCounter, outfp);
     /* output exceptions table */
     outshort2char(mymethod.ExceptionsCounter,outfp); 
     for(exceptionentry* tempexception = mymethod.exceptionhead;
@@ -1187,97 +1266,109 @@ void MethodDump(MethodInfo mymethod, FILE* outfp)
         
 
 
+/* returns the size of the whole class file, so that EndAssembler can
+   allocate its buffer once */
+long ClassFileSize()
+{
+  long size;
+  size = 8;                                  /* magic and version */
+  size += ConstPoolDumpSize();
+  size += 6;                                 /* access, this and super */
+  size += 2 + 2 * ThisClass.interfacecount;
+  size += 2;
+  for (int k=1;k<=FieldCount;k++)
+  {
+    size += 8;
+    if (field[k].constantvalue_index != 0) size += 8;
+  }
+  size += 2 + MethodsBuffer.length;
+  size += 2;
+  if (ThisClass.sourcefileindex != -1) size += 8;
+  return size;
+}
+
 void EndAssembler()
 {
    FILE *outfp;
-   int i;
-   methodname *tempmethodname;
-   methodname *todiemethodname;
+   ByteBuffer classbuf;
+   ByteBuffer* outbuf;
    interfaceentry* tempinterface;
    interfaceentry* todieinterface;
 
-   if ((outfp = fopen(ConsStrings(GetThisClass(),".class"), "w")) == 0)
-     perror("out.class"), exit(1);
+   classbuf.bytes = NULL;
+   classbuf.length = 0;
+   classbuf.size = 0;
+   outbuf = &classbuf;
+   ReserveBytes(outbuf, ClassFileSize());
+
    /* Header Info */
-   putc(0xCA, outfp); /* magic number */
-   putc(0xFE, outfp);
-   putc(0xBA, outfp);
-   putc(0xBE, outfp);
-   putc(0x00, outfp); /* minor version */
-   putc(0x02, outfp);
-   putc(0x00, outfp); /* major version */
-   putc(0x2E, outfp);
+   outlong2char(0xCAFEBABE, outbuf); /* magic number */
+   outshort2char(0x0002, outbuf); /* minor version */
+   outshort2char(0x002E, outbuf); /* major version */
    
-   i = 0;
    printf("\nConstPool Dump:\n");
-   ConstPoolDump(outfp);
+   ConstPoolDump(outbuf);
    printf("\nEnd of ConstPool Dump\n");
-   outshort2char(ThisClass.access_flags, outfp); /* Access info */
-   outshort2char(ThisClass.classindex, outfp);
-   outshort2char(ThisClass.superclassindex, outfp);
+   outshort2char(ThisClass.access_flags, outbuf); /* Access info */
+   outshort2char(ThisClass.classindex, outbuf);
+   outshort2char(ThisClass.superclassindex, outbuf);
 
    /* output interfaces (that this class implements) */
-   outshort2char(ThisClass.interfacecount, outfp);
+   outshort2char(ThisClass.interfacecount, outbuf);
    tempinterface = ThisClass.interfacehead;
    while (tempinterface != NULL)
    {
-     outshort2char(tempinterface->index, outfp);
+     outshort2char(tempinterface->index, outbuf);
      todieinterface = tempinterface;
      tempinterface = tempinterface->next;
      free(todieinterface);
    }
  
    /* output fields */
-   outshort2char(FieldCount, outfp);
+   outshort2char(FieldCount, outbuf);
    for (int k=1;k<=FieldCount;k++)
    {
-     outshort2char(field[k].access_flags, outfp);
-     outshort2char(field[k].name_index, outfp);
-     outshort2char(field[k].signature_index, outfp);
+     outshort2char(field[k].access_flags, outbuf);
+     outshort2char(field[k].name_index, outbuf);
+     outshort2char(field[k].signature_index, outbuf);
      if (field[k].constantvalue_index != 0)
      {
-       outshort2char(1,outfp); /*attributes count*/
-       outshort2char(GenConst(CONSTANT_Utf8,"ConstantValue"), outfp);
-       outlong2char(2, outfp); /* attribute length */
-       outshort2char(field[k].constantvalue_index, outfp);
+       outshort2char(1,outbuf); /*attributes count*/
+       outshort2char(GenConst(CONSTANT_Utf8,"ConstantValue"), outbuf);
+       outlong2char(2, outbuf); /* attribute length */
+       outshort2char(field[k].constantvalue_index, outbuf);
      }
      else
      {
-       outshort2char(0, outfp); /*attributes count*/
+       outshort2char(0, outbuf); /*attributes count*/
      }
    }
-   outshort2char(MethodCount, outfp);
-   //printf("\nCode Dump:\n");
-   /* will want to go through linked list of method's file names and copy
-      them into outfp */
-   tempmethodname = methodnameshead;
-   while(tempmethodname != NULL)
-   {  
-     CopyMethod(tempmethodname->name, outfp);
-     remove(tempmethodname->name);
-     todiemethodname = tempmethodname;
-     tempmethodname = tempmethodname->next;
-     free(todiemethodname);
-   }
-   /*for (int j=1;j<=MethodCount;j++)
-   {
-     MethodDump(method[j], outfp);
-   }
-   */
+   outshort2char(MethodCount, outbuf);
+   /* the methods were already dumped in order by EndMethod */
+   outbytes(MethodsBuffer.bytes, MethodsBuffer.length, outbuf);
+   free(MethodsBuffer.bytes);
+   MethodsBuffer.bytes = NULL;
+   MethodsBuffer.size = 0;
    if (ThisClass.sourcefileindex == -1)
    {
-     outshort2char(0, outfp); /*attributes count*/
+     outshort2char(0, outbuf); /*attributes count*/
    }
    else
    {
-     outshort2char(1, outfp); /*attributes count*/
-     outshort2char(GenConst(CONSTANT_Utf8,"SourceFile"), outfp); /* just a 
+     outshort2char(1, outbuf); /*attributes count*/
+     outshort2char(GenConst(CONSTANT_Utf8,"SourceFile"), outbuf); /* just a 
 						lookup at this point */
-     outlong2char(2, outfp);  /*attribute length*/
-     outshort2char(ThisClass.sourcefileindex, outfp);
+     outlong2char(2, outbuf);  /*attribute length*/
+     outshort2char(ThisClass.sourcefileindex, outbuf);
    }
-   //printf("\nEnd of Code Dump\n");
-   fclose(outfp);
+
+   /* now the whole class goes out with a single write */
+   if ((outfp = fopen(ConsStrings(GetThisClass(),".class"), "wb")) == 0)
+     perror("out.class"), exit(1);
+   if (fwrite(classbuf.bytes, 1, classbuf.length, outfp) != 
+       (size_t) classbuf.length || fclose(outfp) != 0)
+     oops("Couldn't write the class file");
+   free(classbuf.bytes);
 }
 
 
@@ -1296,7 +1387,7 @@ void GenNoArgCode(int opcode)
 
 void GenOneArgCode(int opcode, ArgType arg1)
 {
-   short int mytemp;
+   int mytemp;
    //message("In GenOneArgCode");
    //printf("The opcode is : %i\n", GetOpCode(opcode));
    //AddToCode(GetOpCode(opcode));
@@ -1477,144 +1568,93 @@ void GenLabelArgCode(int opcode, char* arg1)
 {
    signed long location;
    signed long offset;
-   /* need to see if offset big enough to need goto_w, jsr_w, etc. */
+   long opcodelocation;
+   int labelptr;
+   int wide;
    //message("In GenLabelArgCode");
-   location = GetLabel(arg1, currentmethod.CodeCounter, 
-			currentmethod.CodeCounter + 1);
-   offset = location - (currentmethod.CodeCounter); /* not a valid
-					value if location is -1 */	
+   opcodelocation = currentmethod.CodeCounter;
+   labelptr = FindLabel(arg1);
+   if (labelptr < 0) labelptr = NewLabel(arg1);
+   location = currentmethod.Label[labelptr].index;
+   offset = location - opcodelocation; /* not a valid value if location
+					   is -1 */
+   /* decide between the 2 and 4 byte forms where we can; a short branch
+      that turns out to be too far away is widened by RelaxBranches when
+      the method ends */
+   wide = 0;
    switch (opcode)
    {
-     case (IFEQ):
-     case (IFLT):
-     case (IFLE):
-     case (IFGT):
-     case (IFGE):
-     case (IFNE):
-     case (IFNULL):
-     case (IFNONNULL):
-     case (IF_ICMPEQ):
-     case (IF_ICMPNE):
-     case (IF_ICMPLT):
-     case (IF_ICMPGT):
-     case (IF_ICMPLE):
-     case (IF_ICMPGE):
-     case (IF_ACMPEQ):
-     case (IF_ACMPNE):
-     {
-       AddToCode(GetOpCode(opcode));
-       if (location == -1) /* label not yet defined */
-       {
-	 AddShortToCode((signed short) 0); /*place holder*/
-       }
-       else
-       {
-         if ((offset > 32767) || (offset < -32768))
-	 {
-	   oops("instruction used label that's too far away.");
-	 }
-	 else
-	 {
-	   AddShortToCode((signed short) offset);
-	 }
-       }
-       break;
-     }
      case (GOTO):
      {
-       if (location == -1) /* label not yet defined */
-       {
-         // AddToCode(GetOpCode(GOTO_W));
-	 // AddLongToCode((signed long) 0); /*place holder*/
-          AddToCode(GetOpCode(GOTO));
-	  AddShortToCode((signed short) 0); /*place holder*/
-       }
-       else
+       if (location != -1 && ((offset > 32767) || (offset < -32768)))
        {
-         if ((offset > 32767) || (offset < -32768))
-	 {
-	   message("Using GOTO_W");
-           AddToCode(GetOpCode(GOTO_W));
-	   AddLongToCode(offset);
-	 }
-	 else
-	 {
-           AddToCode(GetOpCode(opcode));
-	   AddShortToCode((signed short) offset);
-	 }
+	 message("Using GOTO_W");
+	 opcode = GOTO_W;
+	 wide = 1;
        }
        break;
      }
      case (JSR):
      {
-       if (location == -1) /* label not yet defined */
-       {
-         AddToCode(GetOpCode(JSR_W));
-	 AddLongToCode((signed long) 0); /*place holder*/
-       }
-       else
+       if (location == -1 || (offset > 32767) || (offset < -32768))
        {
-         if ((offset > 32767) || (offset < -32768))
-	 {
-	   message("Using JSR_W");
-           AddToCode(GetOpCode(JSR_W));
-	   AddLongToCode(offset); 
-	 }
-	 else
-	 {
-           AddToCode(GetOpCode(opcode));
-	   AddShortToCode((signed short) offset);
-	 }
+	 if (location != -1) message("Using JSR_W");
+	 opcode = JSR_W;
+	 wide = 1;
        }
        break;
      }
      case (GOTO_W):
+     case (JSR_W):
      {
-       if (location == -1) /* label not yet defined */
-       {
-         AddToCode(GetOpCode(opcode));
-	 AddLongToCode((signed long) 0); /*place holder*/
-       }
-       else
+       if (location == -1 || (offset > 32767) || (offset < -32768))
        {
-         if ((offset > 32767) || (offset < -32768))
-	 {
-           AddToCode(GetOpCode(opcode));
-	   AddLongToCode(offset); 
-	 }
-	 else
-	 {
-	   message("Optimizing: using GOTO");
-           AddToCode(GetOpCode(GOTO));
-	   AddShortToCode((signed short) offset);
-	 }
+	 wide = 1;
        }
-       break;
-     }
-     case (JSR_W):
-     {
-       if (location == -1) /* label not yet defined */
+       else if (opcode == GOTO_W)
        {
-         AddToCode(GetOpCode(opcode));
-	 AddLongToCode((signed long) 0); /*place holder*/
+	 message("Optimizing: using GOTO");
+	 opcode = GOTO;
        }
        else
        {
-         if ((offset > 32767) || (offset < -32768))
-	 {
-           AddToCode(GetOpCode(opcode));
-	   AddLongToCode(offset); 
-	 }
-	 else
-	 {
-	   message("Optimizing: using JSR");
-           AddToCode(GetOpCode(JSR));
-	   AddShortToCode((signed short) offset);
-	 }
+	 message("Optimizing: using JSR");
+	 opcode = JSR;
        }
        break;
      }
    }
+   AddToCode(GetOpCode(opcode));
+   if (wide)
+   {
+     AddBranchSite(opcodelocation, WIDEBRANCHSITE, labelptr);
+     if (location == -1) /* label not yet defined */
+     {
+       GetLabel(arg1, opcodelocation, currentmethod.CodeCounter, 4);
+       AddLongToCode((signed long) 0); /*place holder*/
+     }
+     else
+     {
+       AddLongToCode(offset);
+     }
+   }
+   else
+   {
+     AddBranchSite(opcodelocation, BRANCHSITE, labelptr);
+     if (location == -1) /* label not yet defined */
+     {
+       GetLabel(arg1, opcodelocation, currentmethod.CodeCounter, 2);
+       AddShortToCode((signed short) 0); /*place holder*/
+     }
+     else if ((offset > 32767) || (offset < -32768))
+     {
+       AddShortToCode((signed short) 0); /* RelaxBranches will fix it */
+     }
+     else
+     {
+       AddShortToCode((signed short) offset);
+     }
+   }
 }
 
 void GenLocalVarArgCode(int opcode, int index)
@@ -1715,8 +1755,9 @@ void GenLocalVarArgCode(int opcode, int index)
       }
    }
    
-   /* need to check if index is big enough to need use of wide statement */
-   if (index > CHAR_MAX)
+   /* need to check if index is big enough to need use of wide statement;
+      the index is an unsigned byte */
+   if (index > UCHAR_MAX)
    {
      /* make sure the user didn't put out a wide statement already*/ 
      if(currentmethod.Code[currentmethod.CodeCounter-1] !=
@@ -2072,8 +2113,7 @@ void GenIINCCode(int opcode, int index, int myconst)
      oops("Constant too big for IINC instruction.");
    }
    message("In GenIINCCode.");
-   printf("%i\n",myconst);
-   if (index > CHAR_MAX)
+   if (index > UCHAR_MAX)
    {
      /* make sure the user didn't put out a wide statement already*/ 
      if(currentmethod.Code[currentmethod.CodeCounter-1] !=
@@ -2083,7 +2123,7 @@ void GenIINCCode(int opcode, int index, int myconst)
      }
      AddToCode(GetOpCode(opcode));
      AddShortToCode(index);
-     AddToCode((char)myconst);
+     AddShortToCode(myconst);  /* wide iinc takes a 2 byte constant */
    }
    else
    {
@@ -2099,6 +2139,32 @@ void GenNEWARRAYCode(int opcode, int atype)
    AddToCode((char) atype);
 }
 
+/* adds the 4 byte offset from a switch at opcodelocation to alabel */
+void AddSwitchTarget(char* alabel, long opcodelocation)
+{
+   int labelptr;
+   long location;
+   labelptr = FindLabel(alabel);
+   if (labelptr < 0) labelptr = NewLabel(alabel);
+   currentmethod.SwitchTarget = (int*) GrowTable(currentmethod.SwitchTarget,
+			&currentmethod.SwitchTargetSize,
+			currentmethod.SwitchTargetCounter + 1, sizeof(int));
+   currentmethod.SwitchTarget[currentmethod.SwitchTargetCounter++] = labelptr;
+   location = GetLabel(alabel, opcodelocation, currentmethod.CodeCounter, 4);
+   if (location == -1)
+     AddLongToCode(0); /*place holder*/
+   else
+     AddLongToCode(location - opcodelocation);
+}
+
+/* adds the padding that puts the operands of a switch at opcodelocation on
+   a 4 byte boundary */
+void AddSwitchPadding(long opcodelocation)
+{
+   for (int i = 3 - opcodelocation % 4; i > 0; i--)
+     AddToCode(0); /* filler byte */
+}
+
 void GenLOOKUPSWITCHCode(int opcode, char* mydefault, lookupentry* head)
 {
    int opcodelocation;
@@ -2106,16 +2172,11 @@ void GenLOOKUPSWITCHCode(int opcode, char* mydefault, lookupentry* head)
    lookupentry* tempptr;
    lookupentry* todie;
    opcodelocation = currentmethod.CodeCounter;
+   AddBranchSite(opcodelocation, SWITCHSITE, -1);
    AddToCode(GetOpCode(opcode));
-   /* add byte pad */
-   for (int i = opcodelocation % 4; (i%4 != 0); i++)
-   {
-     AddToCode(0); /* filler byte */
-     /* i++;*/ /* isn't this redundant???? Yes, it is!!!*/
-   }
+   AddSwitchPadding(opcodelocation);
    /* add mydefault offset */
-   AddLongToCode(opcodelocation - GetLabel(mydefault,opcodelocation,
-			  	     	   currentmethod.CodeCounter));
+   AddSwitchTarget(mydefault, opcodelocation);
    /* count npairs */
    j = 0;
    tempptr = head;
@@ -2130,33 +2191,26 @@ void GenLOOKUPSWITCHCode(int opcode, char* mydefault, lookupentry* head)
    while (tempptr != NULL)
    {
      AddLongToCode(tempptr->match);
-     AddLongToCode(opcodelocation - GetLabel(tempptr->alabel,opcodelocation,
-			  	     	   currentmethod.CodeCounter));
+     AddSwitchTarget(tempptr->alabel, opcodelocation);
      todie = tempptr;
      tempptr = tempptr->next;
      free(todie);
    }
+   EndBranchSite();
 }
 
 void GenTABLESWITCHCode(int opcode, int mylow, int myhigh, 
 			char* mydefault, tableentry* head)
 {
    int opcodelocation;
-   long j;
    tableentry* tempptr;
    tableentry* todie;
    opcodelocation = currentmethod.CodeCounter;
+   AddBranchSite(opcodelocation, SWITCHSITE, -1);
    AddToCode(GetOpCode(opcode));
-   /* add byte pad */
-   for (int i = opcodelocation % 4; (i%4 != 0); i++)
-   {
-     AddToCode(0); /* filler byte */
-     i++; /* isn't this redundant???? */
-   }
+   AddSwitchPadding(opcodelocation);
    /* add mydefault offset */
-   AddLongToCode(opcodelocation - GetLabel(mydefault,opcodelocation,
-			  	     	   currentmethod.CodeCounter));
-   /* count npairs */
+   AddSwitchTarget(mydefault, opcodelocation);
    AddLongToCode(mylow);
    AddLongToCode(myhigh);
 
@@ -2164,23 +2218,27 @@ void GenTABLESWITCHCode(int opcode, int mylow, int myhigh,
    tempptr = head;
    while (tempptr != NULL)
    {
-     AddLongToCode(opcodelocation - GetLabel(tempptr->alabel,opcodelocation,
-			  	     	   currentmethod.CodeCounter));
+     AddSwitchTarget(tempptr->alabel, opcodelocation);
      todie = tempptr;
      tempptr = tempptr->next;
      free(todie);
    }
+   EndBranchSite();
 }
      
 
 void NewNewMethod(int access)
 {
+   if (MethodCount >= MAXCOUNT)
+     oops("Too many methods in class (the class file limit is 65535).");
    MethodCount++;
    currentmethod.access_flags = access;  
    currentmethod.CodeCounter = 0;
    GenConst(CONSTANT_Utf8, "Code");  /* note: don't need this if no code
 					ever generated */
-   currentmethod.LabelCounter = 0; 
+   ResetLabels();
+   currentmethod.SiteCounter = 0;
+   currentmethod.SwitchTargetCounter = 0;
    currentmethod.LocalVarCounter = -1;
    currentmethod.ExceptionsCounter = 0;
    currentmethod.exceptionhead = NULL;
@@ -2213,42 +2271,22 @@ void NewMethod(char* name, char* signature, int maxstack, int maxlocals)
 
 void EndMethod()
 {
-   FILE * myoutfp;
-   methodname * tempmethodname;
-   methodname * prevmethodname;
-   methodname * newmethodname;
-
-   /* add new method name to the list*/
-   tempmethodname = methodnameshead;
-   newmethodname = (methodname *) malloc(sizeof(methodname));
-   newmethodname->next = NULL;
-   if (tempmethodname == NULL)
-   {
-     methodnameshead = newmethodname;
-   }
-   else
-   {
-     while (tempmethodname != NULL)
-     {
-	prevmethodname = tempmethodname;
-	tempmethodname = tempmethodname->next;
-     }
-     prevmethodname->next = newmethodname;
-   }
-
-   /* create a temp file name and open a new file */
-   tmpnam(newmethodname->name); 
-   if ((myoutfp = fopen(newmethodname->name, "w")) == 0)
-     perror("cannot open file"), exit(1);
-   MethodDump(currentmethod,myoutfp);
-   fclose(myoutfp);
+   RelaxBranches();
+   if (currentmethod.max_stack < 0 || currentmethod.max_locals < 0)
+      ComputeFrameSize();
+   MethodDump(currentmethod,&MethodsBuffer);
 }
    
 
 /* maybe overload this for the case of constants */
 void NewField(int access, char* name, char* signature, ArgType constantval)
 {
+   if (FieldCount >= MAXCOUNT)
+     oops("Too many fields in class (the class file limit is 65535).");
    FieldCount++;
+   /* field is indexed from 1 */
+   field = (FieldInfo*) GrowTable(field, &FieldSize, FieldCount + 1,
+                                  sizeof(FieldInfo));
    field[FieldCount].access_flags = access;
    field[FieldCount].name_index = GenConst(CONSTANT_Utf8, name);
    field[FieldCount].signature_index = GenConst(CONSTANT_Utf8, signature);
@@ -2312,16 +2350,21 @@ reference to that variable, or should this be user-defined? */
 void NewLocalVar(char* name, char* signature)
 {
    /* do we need to search to see if this variable has already been defined? */
-   short currentspot;
-   short tempslot;
+   int currentspot;
+   int tempslot;
+   if (currentmethod.LocalVarCounter + 1 >= MAXCOUNT)
+     oops("Too many local variables in method (the class file limit is 65535).");
    currentmethod.LocalVarCounter++;
    currentspot = currentmethod.LocalVarCounter;
+   currentmethod.LocalVar = (LocalVarInfo*) GrowTable(currentmethod.LocalVar,
+                                  &currentmethod.LocalVarSize,
+                                  currentspot + 1, sizeof(LocalVarInfo));
    if (name != NULL)
    {
       currentmethod.LocalVar[currentspot].name_index =
 				GenConst(CONSTANT_Utf8, name);
       currentmethod.LocalVar[currentspot].name = 
-			(char *) malloc(strlen(name));
+			(char *) malloc(strlen(name)+1);
       strcpy(currentmethod.LocalVar[currentspot].name, name);
    }
    else
@@ -2332,7 +2375,7 @@ void NewLocalVar(char* name, char* signature)
    currentmethod.LocalVar[currentspot].signature_index =
 				GenConst(CONSTANT_Utf8, signature);
    currentmethod.LocalVar[currentspot].signature = 
-			(char *) malloc(strlen(signature));
+			(char *) malloc(strlen(signature)+1);
    strcpy(currentmethod.LocalVar[currentspot].signature, signature);
    currentmethod.LocalVar[currentspot].start_pc = -1; 
    currentmethod.LocalVar[currentspot].length = 0;
@@ -2353,6 +2396,8 @@ void NewLocalVar(char* name, char* signature)
       currentmethod.currentslot = tempslot +1;
       //message("Incremented slot by 1.");
    }
+   if (currentmethod.currentslot > MAXCOUNT)
+     oops("Too many local variable slots in method (the class file limit is 65535).");
 
    GenConst(CONSTANT_Utf8, "LocalVariableTable");  /* note: don't need this if 
 					no local var table ever generated */
@@ -2360,7 +2405,7 @@ void NewLocalVar(char* name, char* signature)
 
 void IncrementLocalVarSlot(char* signature)
 {
-   short tempslot;
+   int tempslot;
    tempslot = currentmethod.currentslot;
    if ((strcmp(signature, "J") ==0) || (strcmp(signature, "D") ==0))  
       /* long or double so takes up two slots */
@@ -2373,6 +2418,8 @@ void IncrementLocalVarSlot(char* signature)
       currentmethod.currentslot = tempslot +1;
       //message("Incremented slot by 1.");
    }
+   if (currentmethod.currentslot > MAXCOUNT)
+     oops("Too many local variable slots in method (the class file limit is 65535).");
 }
 
 char* GetLocalVarSigFromSlot(int index)
@@ -2402,145 +2449,679 @@ short GetLocalVar(char* name)
 }
 
 
-void DefineLabel(char* name)
+/* Labels are kept per method in currentmethod.Label, which grows as needed,
+and are found through a chained hash table on their names: LabelHash holds
+the Label index of the first label in each bucket (-1 if it is empty) and
+the rest of the bucket is chained through hashnext.
+*/
+#define LABELHASHINITSIZE 64
+
+void LabelHashLink(int labelptr)
 {
-   int i;
-   unresolvedindex* j;
-   unresolvedindex* todie;
-   int k;
-   long t1, t2, t3,t4;
-   int labelptr;
-   labelptr = -1;
-   for (i=0;i<currentmethod.LabelCounter;i++)
+   int bucket;
+   char* name;
+   name = currentmethod.Label[labelptr].name;
+   bucket = HashBytes(2166136261UL, name, strlen(name)) &
+	    (currentmethod.LabelHashSize - 1);
+   currentmethod.Label[labelptr].hashnext = currentmethod.LabelHash[bucket];
+   currentmethod.LabelHash[bucket] = labelptr;
+}
+
+/* forgets the labels of the previous method */
+void ResetLabels()
+{
+   if (currentmethod.LabelHash == NULL)
    {
-     if (strcmp(name, currentmethod.Label[i].name) == 0)
-        labelptr = i;
+      currentmethod.LabelHashSize = LABELHASHINITSIZE;
+      currentmethod.LabelHash = (int*) malloc(LABELHASHINITSIZE * sizeof(int));
+      if (currentmethod.LabelHash == NULL) oops("Out of memory for labels");
    }
-   if (labelptr >= 0) /*label with same name already found*/
+   for (int i = 0; i < currentmethod.LabelHashSize; i++)
+      currentmethod.LabelHash[i] = -1;
+   currentmethod.LabelCounter = 0;
+}
+
+/* returns the Label index of name, or -1 if it hasn't been seen yet */
+int FindLabel(char* name)
+{
+   int i;
+   i = currentmethod.LabelHash[HashBytes(2166136261UL, name, strlen(name)) &
+			       (currentmethod.LabelHashSize - 1)];
+   while (i >= 0 && strcmp(name, currentmethod.Label[i].name) != 0)
+      i = currentmethod.Label[i].hashnext;
+   return i;
+}
+
+/* adds name as a label that isn't defined yet and returns its Label index */
+int NewLabel(char* name)
+{
+   int labelptr;
+   labelptr = currentmethod.LabelCounter++;
+   currentmethod.Label = (LabelInfo*) GrowTable(currentmethod.Label,
+				&currentmethod.LabelSize,
+				currentmethod.LabelCounter, sizeof(LabelInfo));
+   currentmethod.Label[labelptr].name = name;
+   currentmethod.Label[labelptr].index = -1;
+   currentmethod.Label[labelptr].unresolvedindexhead = NULL;
+   if (currentmethod.LabelCounter > currentmethod.LabelHashSize / 2)
    {
-     if (currentmethod.Label[labelptr].index == -1)/*label not yet defined*/
-     {
-    	currentmethod.Label[labelptr].index 
-		= currentmethod.CodeCounter;
-	j = currentmethod.Label[labelptr].unresolvedindexhead;
-	while (j != NULL) /* fix all unresolved references */
- 	{
- 	  if((currentmethod.Code[j->location-1] == GetOpCode(IFEQ))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IFLT))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IFLE))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IFGT))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IFGE))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IFNE))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IFNULL))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IFNONNULL))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IF_ICMPEQ))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IF_ICMPNE))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IF_ICMPLT))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IF_ICMPGT))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IF_ICMPLE))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IF_ICMPGE))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IF_ACMPEQ))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(IF_ACMPNE))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(GOTO))
- 	   ||(currentmethod.Code[j->location-1] == GetOpCode(JSR)))
-	  {
-	    if ((currentmethod.CodeCounter-(j->location-1) > 32767)
-	     || (currentmethod.CodeCounter-(j->location-1) < -32768))
-		oops("instruction used label that's too far away.");
-	    copyshort2char(&currentmethod.Code[j->location],
-		(signed short) currentmethod.CodeCounter
-			       - (j->opcodelocation));
-	    todie = j;
-	    j = j->next;
- 	    free(todie);
-	  }
-	  else
-	  {
-	    copylong2char(&currentmethod.Code[j->location],
-			currentmethod.CodeCounter-(j->opcodelocation));
-	    todie = j;
-	    j = j->next;
- 	    free(todie);
-	  }
-	  currentmethod.Label[labelptr].unresolvedindexhead = NULL;
-      	}
-     }
-     else
-     {
- 	oops("label already defined!");
-     }
+      currentmethod.LabelHashSize *= 2;
+      free(currentmethod.LabelHash);
+      currentmethod.LabelHash = (int*) malloc(currentmethod.LabelHashSize *
+					      sizeof(int));
+      if (currentmethod.LabelHash == NULL) oops("Out of memory for labels");
+      for (int i = 0; i < currentmethod.LabelHashSize; i++)
+	 currentmethod.LabelHash[i] = -1;
+      for (int i = 0; i < labelptr; i++)
+	 LabelHashLink(i);
    }
-   else /* label not yet defined */
+   LabelHashLink(labelptr);
+   return labelptr;
+}
+
+void DefineLabel(char* name)
+{
+   int labelptr;
+   long offset;
+   unresolvedindex* j;
+   unresolvedindex* todie;
+   labelptr = FindLabel(name);
+   if (labelptr < 0)
+      labelptr = NewLabel(name);
+   else if (currentmethod.Label[labelptr].index != -1)
+      oops("label already defined!");
+   currentmethod.Label[labelptr].index = currentmethod.CodeCounter;
+   j = currentmethod.Label[labelptr].unresolvedindexhead;
+   while (j != NULL) /* fix all unresolved references */
    {
-	currentmethod.Label[currentmethod.LabelCounter].name = name;
-	currentmethod.Label[currentmethod.LabelCounter].index = 
-		currentmethod.CodeCounter;
-	currentmethod.Label[currentmethod.LabelCounter].unresolvedindexhead = NULL;
-	currentmethod.LabelCounter++;
-        //message(ConsStrings("Label added: ", name));
+      offset = currentmethod.CodeCounter - j->opcodelocation;
+      if (j->size == 2)
+      {
+	 /* a branch that doesn't reach is left for RelaxBranches */
+	 if ((offset <= 32767) && (offset >= -32768))
+	    copyshort2char(&currentmethod.Code[j->location], (short) offset);
+      }
+      else
+      {
+	 copylong2char(&currentmethod.Code[j->location], offset);
+      }
+      todie = j;
+      j = j->next;
+      free(todie);
    }
+   currentmethod.Label[labelptr].unresolvedindexhead = NULL;
 }
 
 
+/* returns the location of a label if it is defined, otherwise -1 */
+long LabelIndex(char* name)
+{
+   int labelptr;
+   labelptr = FindLabel(name);
+   if (labelptr < 0) return -1;
+   return currentmethod.Label[labelptr].index;
+}
+
 /*This function returns the location of a label if it is defined.  If it is
   not defined, it adds "location" to the list of unresolved references.
   myopcodelocation is the offset from the beginning of the code of the
   opcode that uses this label (used for calculating the real offset later).
   mylocation is the offset from the beginning of the code where the label's
-  offset belongs.
+  offset belongs, and mysize is the size of that offset, 2 or 4 bytes.
 */
-signed long GetLabel(char* name, long myopcodelocation, long mylocation)
+signed long GetLabel(char* name, long myopcodelocation, long mylocation,
+		     int mysize)
 {
-   int i;
    int labelptr;
-   long toreturn;
-   labelptr = -1;
-   unresolvedindex* lastindex;
-   for (i=0;i<currentmethod.LabelCounter;i++)
+   unresolvedindex* toadd;
+   labelptr = FindLabel(name);
+   if (labelptr < 0)
+      labelptr = NewLabel(name);
+   if (currentmethod.Label[labelptr].index >= 0)
    {
-     if (strcmp(name, currentmethod.Label[i].name) == 0)
-        labelptr = i;
+      /* let's just return the index instead of the actual offset 
+	 (for cases like tableswitch and lookupswitch where the offset
+	  is calculated from a few bytes back, not just one. */
+      return currentmethod.Label[labelptr].index;
+   }
+   /*add this to list of unresolved indexes*/ 
+   toadd = (unresolvedindex*) malloc(sizeof(unresolvedindex));
+   toadd->location = mylocation;
+   toadd->opcodelocation = myopcodelocation;
+   toadd->size = mysize;
+   toadd->next = currentmethod.Label[labelptr].unresolvedindexhead;
+   currentmethod.Label[labelptr].unresolvedindexhead = toadd;
+   return -1;
+}
+ 
+
+/* Branch relaxation.  Every instruction that refers to a label is recorded
+in currentmethod.Site as it is generated.  Branches start out in their
+2 byte form, and when the method ends RelaxBranches checks them against the
+final label positions.  Any that don't reach are widened: goto and jsr
+become goto_w and jsr_w, and a conditional branch becomes the inverted
+condition jumping over a goto_w.  Widening moves the code after it (and
+changes the padding of any switch that follows), which can push other
+branches out of range, so this is repeated until nothing more needs
+widening.  The code is then rebuilt once, and the labels and the exception,
+line number and local variable tables are moved to the new locations.
+*/
+void AddBranchSite(long location, int kind, int labelptr)
+{
+   BranchSite* site;
+   currentmethod.Site = (BranchSite*) GrowTable(currentmethod.Site,
+			&currentmethod.SiteSize,
+			currentmethod.SiteCounter + 1, sizeof(BranchSite));
+   site = &currentmethod.Site[currentmethod.SiteCounter++];
+   site->location = location;
+   site->length = (kind == BRANCHSITE) ? 3 : 5;
+   site->kind = kind;
+   site->widened = 0;
+   site->labelptr = labelptr;
+   site->firsttarget = currentmethod.SwitchTargetCounter;
+}
+
+/* records the length of a switch, once all of it has been generated */
+void EndBranchSite()
+{
+   BranchSite* site;
+   site = &currentmethod.Site[currentmethod.SiteCounter - 1];
+   site->length = currentmethod.CodeCounter - site->location;
+}
+
+int SwitchPadding(long opcodelocation)
+{
+   return 3 - opcodelocation % 4;
+}
+
+/* the length of a site placed at newlocation */
+int RelaxedLength(BranchSite* site, long newlocation)
+{
+   switch (site->kind) {
+     case BRANCHSITE:
+       if (!site->widened) return 3;
+       if (JvmInvertBranch((unsigned char) currentmethod.Code[site->location])
+	   < 0)
+	 return 5;  /* goto_w or jsr_w */
+       return 8;    /* inverted branch around a goto_w */
+     case WIDEBRANCHSITE:
+       return 5;
+     default:
+       return site->length - SwitchPadding(site->location)
+			   + SwitchPadding(newlocation);
    }
-   if (labelptr >= 0)
+}
+
+/* the location that pc moves to, given how much each site grows; shift[i]
+   is how far site i itself moves */
+long RelaxedLocation(long pc, long* shift)
+{
+   int low, high, mid;
+   /* find the number of sites before pc */
+   low = 0;
+   high = currentmethod.SiteCounter;
+   while (low < high)
    {
-     if (currentmethod.Label[labelptr].index >= 0)
-     {
-	/* let's just return the index instead of the actual offset 
-	   (for cases like tableswitch and lookupswitch where the offset
-	    is calculated from a few bytes back, not just one. */
-        return currentmethod.Label[labelptr].index;
-     }
-     else /*add this to list of unresolved indexes*/ 
-     {
-	lastindex = currentmethod.Label[labelptr].unresolvedindexhead;
-	currentmethod.Label[labelptr].unresolvedindexhead =
-			(unresolvedindex*) malloc(sizeof(unresolvedindex));
-	currentmethod.Label[labelptr].unresolvedindexhead->location =
-			mylocation;
-	currentmethod.Label[labelptr].unresolvedindexhead->opcodelocation 
-			= myopcodelocation;
-	currentmethod.Label[labelptr].unresolvedindexhead->next =
-			lastindex;
-	return -1;
-     }
+      mid = (low + high) / 2;
+      if (currentmethod.Site[mid].location < pc) low = mid + 1;
+      else high = mid;
    }
-   else /*put label in list with no index*/
+   return pc + shift[low];
+}
+
+void RelaxBranches()
+{
+   BranchSite* site;
+   long* shift;
+   int n;
+   int changed;
+   int widenedany;
+   long newlocation, target, offset, newlength, body;
+   char* newcode;
+   long out;
+   long from;
+   int op;
+
+   for (int i = 0; i < currentmethod.LabelCounter; i++)
+      if (currentmethod.Label[i].index == -1 &&
+	  currentmethod.Label[i].unresolvedindexhead != NULL)
+	 oops(ConsStrings("Label not defined: ", currentmethod.Label[i].name));
+
+   n = currentmethod.SiteCounter;
+   shift = (long*) malloc((n + 1) * sizeof(long));
+   if (shift == NULL) oops("Out of memory for branch relaxation");
+   widenedany = 0;
+   do
    {
-     currentmethod.Label[currentmethod.LabelCounter].name = name;
-     currentmethod.Label[currentmethod.LabelCounter].index = -1;
-     currentmethod.Label[currentmethod.LabelCounter].unresolvedindexhead 
-			= (unresolvedindex*) malloc(sizeof(unresolvedindex));
-     currentmethod.Label[currentmethod.LabelCounter].unresolvedindexhead->location 
-			= mylocation;
-     currentmethod.Label[currentmethod.LabelCounter].unresolvedindexhead->opcodelocation 
-			= myopcodelocation;
-     currentmethod.Label[currentmethod.LabelCounter].unresolvedindexhead->next 
-			= NULL; 
-     currentmethod.LabelCounter++;
-     return -1;
+      changed = 0;
+      shift[0] = 0;
+      for (int i = 0; i < n; i++)
+      {
+	 site = &currentmethod.Site[i];
+	 shift[i + 1] = shift[i] + RelaxedLength(site,
+			site->location + shift[i]) - site->length;
+      }
+      for (int i = 0; i < n; i++)
+      {
+	 site = &currentmethod.Site[i];
+	 if (site->kind != BRANCHSITE || site->widened) continue;
+	 target = RelaxedLocation(currentmethod.Label[site->labelptr].index,
+				  shift);
+	 offset = target - (site->location + shift[i]);
+	 if ((offset > 32767) || (offset < -32768))
+	 {
+	    site->widened = 1;
+	    changed = 1;
+	    widenedany = 1;
+	 }
+      }
+   } while (changed);
+   if (!widenedany)  /* DefineLabel has already patched every offset */
+   {
+      free(shift);
+      return;
    }
+
+   message("Widening branches that are too far away.");
+   newlength = currentmethod.CodeCounter + shift[n];
+   if (newlength > MAXCODE)
+      oops("Method code is longer than 65535 bytes.");
+   newcode = (char*) malloc(newlength > 0 ? newlength : 1);
+   if (newcode == NULL) oops("Out of memory for branch relaxation");
+   out = 0;
+   from = 0;
+   for (int i = 0; i < n; i++)
+   {
+      site = &currentmethod.Site[i];
+      memcpy(&newcode[out], &currentmethod.Code[from], site->location - from);
+      out += site->location - from;
+      newlocation = out;  /* == site->location + shift[i] */
+      op = (unsigned char) currentmethod.Code[site->location];
+      if (site->kind == SWITCHSITE)
+      {
+	 newcode[out++] = op;
+	 for (int k = SwitchPadding(newlocation); k > 0; k--)
+	    newcode[out++] = 0;
+	 body = site->length - 1 - SwitchPadding(site->location);
+	 memcpy(&newcode[out],
+		&currentmethod.Code[site->location + 1 +
+				    SwitchPadding(site->location)], body);
+	 /* the default offset comes first, then the offsets of a
+	    tableswitch follow low and high, and those of a lookupswitch
+	    are paired with their matches */
+	 for (int k = site->firsttarget;
+	      k < currentmethod.SwitchTargetCounter &&
+	      (i + 1 == n || k < currentmethod.Site[i + 1].firsttarget); k++)
+	 {
+	    int t = k - site->firsttarget;
+	    long at;
+	    if (t == 0) at = 0;
+	    else if (op == OP_TABLESWITCH) at = 12 + 4 * (t - 1);
+	    else at = 8 + 8 * (t - 1) + 4;
+	    target = RelaxedLocation(
+		currentmethod.Label[currentmethod.SwitchTarget[k]].index, shift);
+	    copylong2char(&newcode[out + at], target - newlocation);
+	 }
+	 out += body;
+      }
+      else
+      {
+	 target = RelaxedLocation(currentmethod.Label[site->labelptr].index,
+				  shift);
+	 if (site->kind == WIDEBRANCHSITE)
+	 {
+	    newcode[out++] = op;
+	    copylong2char(&newcode[out], target - newlocation);
+	    out += 4;
+	 }
+	 else if (!site->widened)
+	 {
+	    newcode[out++] = op;
+	    copyshort2char(&newcode[out], (short) (target - newlocation));
+	    out += 2;
+	 }
+	 else if (JvmInvertBranch(op) < 0)
+	 {
+	    newcode[out++] = (op == OP_GOTO) ? OP_GOTO_W : OP_JSR_W;
+	    copylong2char(&newcode[out], target - newlocation);
+	    out += 4;
+	 }
+	 else
+	 {
+	    newcode[out++] = JvmInvertBranch(op);
+	    copyshort2char(&newcode[out], 8);  /* past the goto_w */
+	    out += 2;
+	    newcode[out++] = OP_GOTO_W;
+	    copylong2char(&newcode[out], target - (newlocation + 3));
+	    out += 4;
+	 }
+      }
+      from = site->location + site->length;
+   }
+   memcpy(&newcode[out], &currentmethod.Code[from],
+	  currentmethod.CodeCounter - from);
+
+   /* now move everything that holds a code location */
+   for (int i = 0; i < currentmethod.LabelCounter; i++)
+      currentmethod.Label[i].index =
+	 RelaxedLocation(currentmethod.Label[i].index, shift);
+   for (exceptionentry* e = currentmethod.exceptionhead; e != NULL;
+	e = e->next)
+   {
+      e->start_pc = RelaxedLocation((unsigned short) e->start_pc, shift);
+      e->end_pc = RelaxedLocation((unsigned short) e->end_pc, shift);
+      e->handler_pc = RelaxedLocation((unsigned short) e->handler_pc, shift);
+   }
+   for (linenumberentry* l = currentmethod.linenumberhead; l != NULL;
+	l = l->next)
+      l->start_pc = RelaxedLocation((unsigned short) l->start_pc, shift);
+   for (userlocalvarentry* u = currentmethod.userlocalvarhead; u != NULL;
+	u = u->next)
+   {
+      from = (unsigned short) u->start_pc;
+      u->start_pc = RelaxedLocation(from, shift);
+      u->length = RelaxedLocation(from + (unsigned short) u->length, shift)
+		  - (unsigned short) u->start_pc;
+   }
+   for (int i = 0; i <= currentmethod.LocalVarCounter; i++)
+   {
+      if (currentmethod.LocalVar[i].start_pc == -1) continue;
+      from = (unsigned short) currentmethod.LocalVar[i].start_pc;
+      currentmethod.LocalVar[i].start_pc = RelaxedLocation(from, shift);
+      currentmethod.LocalVar[i].length = RelaxedLocation(from +
+		(unsigned short) currentmethod.LocalVar[i].length, shift)
+		- (unsigned short) currentmethod.LocalVar[i].start_pc;
+   }
+
+   free(currentmethod.Code);
+   currentmethod.Code = newcode;
+   currentmethod.CodeSize = newlength > 0 ? newlength : 1;
+   currentmethod.CodeCounter = newlength;
+   free(shift);
+}
+
+
+/* Frame size analysis.  A method declared with "max_stack auto", or with
+no max_stack at all, has its stack depth worked out here from the finished
+code; likewise max_locals when it is omitted or "auto".  The code is walked
+from pc 0 and from every exception handler (which starts with the thrown
+object on the stack), following branches, jsr and switches, and the depth
+before each instruction is recorded the first time it is reached.  Every
+later path to the same instruction has to arrive with the same depth, as
+the verifier requires.  Local slots come from a straight pass over all of
+the instructions, and are never fewer than the arguments and named local
+variables already take.
+*/
+
+/* number of stack words taken by the field descriptor at sig */
+int DescriptorWords(const char* sig)
+{
+   if (*sig == 'V') return 0;
+   if (*sig == 'J' || *sig == 'D') return 2;
+   return 1;
+}
+
+/* the character after the field descriptor at sig */
+const char* SkipDescriptor(const char* sig)
+{
+   while (*sig == '[') sig++;
+   if (*sig == 'L')
+   {
+      while (*sig != '\0' && *sig != ';') sig++;
+   }
+   return (*sig == '\0') ? sig : sig + 1;
+}
+
+/* the descriptor of the field or method referred to by a constant pool
+index, as stored in its NameAndType */
+const char* MemberDescriptor(int cpindex)
+{
+   ConstPoolEntry* entry;
+   if (cpindex <= 0 || cpindex >= ConstPoolIndex)
+      oops("Bad constant pool index in method code.");
+   entry = &ConstPool[ConstPoolSlot[cpindex]];
+   entry = &ConstPool[ConstPoolSlot[entry->index2]];
+   return ConstPool[ConstPoolSlot[entry->index2]].stringval;
+}
+
+/* the stack words used by the arguments of a method descriptor, and those
+taken by its result */
+void MethodWords(const char* sig, int* argwords, int* resultwords)
+{
+   *argwords = 0;
+   if (*sig == '(') sig++;
+   while (*sig != ')' && *sig != '\0')
+   {
+      *argwords += DescriptorWords(sig);
+      sig = SkipDescriptor(sig);
+   }
+   if (*sig == ')') sig++;
+   *resultwords = DescriptorWords(sig);
+}
+
+/* bytes taken by the instruction at pc */
+long InstructionLength(long pc)
+{
+   const char* code = currentmethod.Code;
+   int op = (unsigned char) code[pc];
+   long pad;
+   if (op >= JVM_OPCODE_COUNT || JvmOp(op).mnemonic == NULL)
+      oops("Unknown opcode in method code.");
+   pad = SwitchPadding(pc);
+   switch (op) {
+     case OP_TABLESWITCH:
+       return 1 + pad + 12 + 4 * (copychar2long(&code[pc + 1 + pad + 8]) -
+				  copychar2long(&code[pc + 1 + pad + 4]) + 1);
+     case OP_LOOKUPSWITCH:
+       return 1 + pad + 8 + 8 * copychar2long(&code[pc + 1 + pad + 4]);
+     case OP_WIDE:
+       return ((unsigned char) code[pc + 1] == OP_IINC) ? 6 : 4;
+     default:
+       return JvmOp(op).length;
+   }
+}
+
+/* the words the instruction at pc pops and pushes */
+void StackEffect(long pc, int* pops, int* pushes)
+{
+   const char* code = currentmethod.Code;
+   int op = (unsigned char) code[pc];
+   int argwords, resultwords;
+   const char* sig;
+   switch (op) {
+     case OP_GETSTATIC:
+     case OP_PUTSTATIC:
+     case OP_GETFIELD:
+     case OP_PUTFIELD:
+       sig = MemberDescriptor((unsigned short) copychar2short(&code[pc + 1]));
+       *pops = (op == OP_GETFIELD || op == OP_PUTFIELD) ? 1 : 0;
+       *pushes = 0;
+       if (op == OP_GETSTATIC || op == OP_GETFIELD)
+	  *pushes = DescriptorWords(sig);
+       else
+	  *pops += DescriptorWords(sig);
+       break;
+     case OP_INVOKEVIRTUAL:
+     case OP_INVOKENONVIRTUAL:
+     case OP_INVOKESTATIC:
+     case OP_INVOKEINTERFACE:
+       sig = MemberDescriptor((unsigned short) copychar2short(&code[pc + 1]));
+       MethodWords(sig, &argwords, &resultwords);
+       *pops = argwords + ((op == OP_INVOKESTATIC) ? 0 : 1);
+       *pushes = resultwords;
+       break;
+     case OP_MULTIANEWARRAY:
+       *pops = (unsigned char) code[pc + 3];
+       *pushes = 1;
+       break;
+     case OP_WIDE:
+       *pops = JvmOp((unsigned char) code[pc + 1]).pops;
+       *pushes = JvmOp((unsigned char) code[pc + 1]).pushes;
+       break;
+     default:
+       *pops = JvmOp(op).pops;
+       *pushes = JvmOp(op).pushes;
+       break;
+   }
+}
+
+/* one past the highest local slot the instruction at pc uses, or 0 */
+int LocalsUsed(long pc)
+{
+   const char* code = currentmethod.Code;
+   int op = (unsigned char) code[pc];
+   int slot;
+   int words;
+   if (op >= OP_ILOAD_0 && op <= OP_ALOAD_3)
+   {
+      slot = (op - OP_ILOAD_0) % 4;
+      words = JvmOp(op).pushes;
+   }
+   else if (op >= OP_ISTORE_0 && op <= OP_ASTORE_3)
+   {
+      slot = (op - OP_ISTORE_0) % 4;
+      words = JvmOp(op).pops;
+   }
+   else if (op == OP_WIDE)
+   {
+      op = (unsigned char) code[pc + 1];
+      slot = (unsigned short) copychar2short(&code[pc + 2]);
+      words = JvmOp(op).pushes + JvmOp(op).pops;
+   }
+   else if (JvmOp(op).operands == OPERANDS_LOCAL ||
+	    JvmOp(op).operands == OPERANDS_IINC)
+   {
+      slot = (unsigned char) code[pc + 1];
+      words = JvmOp(op).pushes + JvmOp(op).pops;
+   }
+   else return 0;
+   /* a load pushes, and a store pops, as many words as the slot holds;
+      iinc and ret do neither but use a single slot */
+   return slot + ((words > 0) ? words : 1);
+}
+
+/* records the stack depth on reaching target, queueing it the first time */
+void ReachCode(long target, int depth, int* depthat, long* queue,
+	       long* queued)
+{
+   if (target < 0 || target >= currentmethod.CodeCounter ||
+       depthat[target] == -2)
+      oops("Branch into the middle of an instruction.");
+   if (depthat[target] == -1)
+   {
+      depthat[target] = depth;
+      queue[(*queued)++] = target;
+   }
+   else if (depthat[target] != depth)
+      oops("Stack depth differs on two paths to the same instruction.");
+}
+
+void ComputeFrameSize()
+{
+   const char* code = currentmethod.Code;
+   long codelength = currentmethod.CodeCounter;
+   int* depthat;
+   long* queue;
+   long queued;
+   long pc, length, pad, base, count;
+   int op, depth, maxdepth, pops, pushes, locals;
+
+   /* depthat is -2 inside an instruction and -1 at one not yet reached */
+   depthat = (int*) malloc((codelength + 1) * sizeof(int));
+   queue = (long*) malloc((codelength + 1) * sizeof(long));
+   if (depthat == NULL || queue == NULL)
+      oops("Out of memory for the frame size analysis");
+   for (pc = 0; pc < codelength; pc++) depthat[pc] = -2;
+   locals = currentmethod.currentslot;
+   for (pc = 0; pc < codelength; pc += length)
+   {
+      length = InstructionLength(pc);
+      if (pc + length > codelength) oops("Method code ends in mid instruction.");
+      depthat[pc] = -1;
+      if (LocalsUsed(pc) > locals) locals = LocalsUsed(pc);
+   }
+   if (currentmethod.max_locals < 0)
+   {
+      if (locals > MAXCOUNT)
+	 oops("Too many local variable slots (the class file limit is 65535).");
+      currentmethod.max_locals = locals;
+   }
+   if (currentmethod.max_stack >= 0 || codelength == 0)
+   {
+      if (currentmethod.max_stack < 0) currentmethod.max_stack = 0;
+      free(depthat);
+      free(queue);
+      return;
+   }
+
+   queued = 0;
+   maxdepth = 0;
+   ReachCode(0, 0, depthat, queue, &queued);
+   for (exceptionentry* e = currentmethod.exceptionhead; e != NULL;
+	e = e->next)
+   {
+      ReachCode((unsigned short) e->handler_pc, 1, depthat, queue, &queued);
+      if (maxdepth < 1) maxdepth = 1;
+   }
+   while (queued > 0)
+   {
+      pc = queue[--queued];
+      depth = depthat[pc];
+      op = (unsigned char) code[pc];
+      StackEffect(pc, &pops, &pushes);
+      if (depth < pops) oops("Stack underflow in method code.");
+      depth = depth - pops + pushes;
+      if (depth > maxdepth) maxdepth = depth;
+      switch (op) {
+	case OP_TABLESWITCH:
+	case OP_LOOKUPSWITCH:
+	  pad = SwitchPadding(pc);
+	  base = pc + 1 + pad;
+	  ReachCode(pc + copychar2long(&code[base]), depth, depthat, queue,
+		    &queued);
+	  if (op == OP_TABLESWITCH)
+	  {
+	     count = copychar2long(&code[base + 8]) -
+		     copychar2long(&code[base + 4]) + 1;
+	     for (long k = 0; k < count; k++)
+		ReachCode(pc + copychar2long(&code[base + 12 + 4 * k]), depth,
+			  depthat, queue, &queued);
+	  }
+	  else
+	  {
+	     count = copychar2long(&code[base + 4]);
+	     for (long k = 0; k < count; k++)
+		ReachCode(pc + copychar2long(&code[base + 12 + 8 * k]), depth,
+			  depthat, queue, &queued);
+	  }
+	  continue;
+	case OP_WIDE:
+	  if ((unsigned char) code[pc + 1] == OP_RET) continue;
+	  break;
+	default:
+	  break;
+      }
+      if (JvmIsBranch(op))
+      {
+	 /* jsr pushes its return address for the subroutine, which
+	    has taken it off again by the time control comes back */
+	 ReachCode(pc + ((JvmOp(op).operands == OPERANDS_BRANCH2)
+			 ? copychar2short(&code[pc + 1])
+			 : copychar2long(&code[pc + 1])),
+		   depth, depthat, queue, &queued);
+	 if (op == OP_JSR || op == OP_JSR_W) depth--;
+      }
+      if (op == OP_GOTO || op == OP_GOTO_W || op == OP_RET ||
+	  op == OP_ATHROW || (op >= OP_IRETURN && op <= OP_RETURN))
+	 continue;
+      if (pc + InstructionLength(pc) < codelength)
+	 ReachCode(pc + InstructionLength(pc), depth, depthat, queue, &queued);
+   }
+   if (maxdepth > MAXCOUNT) oops("Stack too deep for the class file.");
+   currentmethod.max_stack = maxdepth;
+   free(depthat);
+   free(queue);
 }
- 
 
 lookupentry* AddToLookupList(lookupentry* head, int mymatch, char* thelabel)
 {
@@ -2581,15 +3162,15 @@ void AddToExceptionList(char* start_pc, char* end_pc, char* handler_pc,
   exceptionentry* tempexception;
   long int tempoffset;
   newexception = (exceptionentry*) malloc(sizeof(exceptionentry));
-  tempoffset = GetLabel(start_pc, 0, 0);
+  tempoffset = LabelIndex(start_pc);
   if (tempoffset == -1) oops("Label not defined.");
   if (tempoffset > 65536) oops("Offset to this label larger than 2 bytes.");
   newexception->start_pc = tempoffset; 
-  tempoffset = GetLabel(end_pc, 0, 0);
+  tempoffset = LabelIndex(end_pc);
   if (tempoffset == -1) oops("Label not defined.");
   if (tempoffset > 65536) oops("Offset to this label larger than 2 bytes.");
   newexception->end_pc = tempoffset; 
-  tempoffset = GetLabel(handler_pc, 0, 0);
+  tempoffset = LabelIndex(handler_pc);
   if (tempoffset == -1) oops("Label not defined.");
   if (tempoffset > 65536) oops("Offset to this label larger than 2 bytes.");
   newexception->handler_pc = tempoffset;
@@ -2622,7 +3203,7 @@ void AddToLineNumberList(char* alabel, short line_number)
   linenumberentry* toadd;
   linenumberentry* temp;
   long tempoffset;
-  tempoffset = GetLabel(alabel, 0, 0);
+  tempoffset = LabelIndex(alabel);
   if (tempoffset == -1) oops("Label not defined.");
   if (tempoffset > 65536) oops("Offset to this label larger than 2 bytes.");
   toadd = (linenumberentry*) malloc(sizeof(linenumberentry));
@@ -2648,11 +3229,11 @@ void AddToUserLocalVarList(char* startlabel, char* endlabel, char* signature,
   userlocalvarentry* temp;
   long tempoffset;
   toadd = (userlocalvarentry*) malloc(sizeof(userlocalvarentry));
-  tempoffset = GetLabel(startlabel, 0, 0);
+  tempoffset = LabelIndex(startlabel);
   if (tempoffset == -1) oops("Label not defined.");
   if (tempoffset > 65536) oops("Offset to this label larger than 2 bytes.");
   toadd->start_pc = tempoffset;
-  tempoffset = GetLabel(endlabel, 0, 0);
+  tempoffset = LabelIndex(endlabel);
   if (tempoffset == -1) oops("Label not defined.");
   if (tempoffset > 65536) oops("Offset to this label larger than 2 bytes.");
   toadd->length = tempoffset - toadd->start_pc;
@@ -274,7 +274,7 @@
 %type <intval> 		methodref_arg_op class_arg_op label_arg_op 
 %type <intval> 		localvar_arg_op localvar_arg newarraytype 
 %type <intval>		access_specifier class_modifiers method_modifiers
-%type <intval>	 	field_modifiers max_locals_decl
+%type <intval>	 	field_modifiers max_stack_decl max_locals_decl
 %type <intval>		abstract_entry final_entry public_entry  
 %type <intval>		interface_entry static_entry native_entry 
 %type <intval>		synchronized_entry transient_entry volatile_entry
@@ -601,14 +601,14 @@ method  :
           METHOD access_specifier method_modifiers {NewNewMethod($2|$3);} 
   	  returntype 
 	  IDENTIFIER 
-	  '(' methodarguments ')' throwslist MAX_STACK INTCONSTANT 
+	  '(' methodarguments ')' throwslist max_stack_decl 
           max_locals_decl 
 	  { 
 	    char* tmpstr; 
 	    /*message("Calling NewMethod.");*/
 	    tmpstr = ConsStrings("(",ConsStrings($8,ConsStrings(")",$5)));
 	    /*message(tmpstr);*/
-	    NewMethod($6, tmpstr, $12, $13); }
+	    NewMethod($6, tmpstr, $11, $12); }
 	    '{'
             code
  	    exceptiontable
@@ -631,9 +631,24 @@ throwsentries :
 		{AddToThrowsList($1);}
      	;
 
+/* -1 has EndMethod work the value out from the code */
+max_stack_decl:
+	MAX_STACK INTCONSTANT
+		{$$ = $2;}
+	| MAX_STACK IDENTIFIER
+		{ if (strcmp($2, "auto") != 0)
+		     oops("max_stack must be a number or auto.");
+		  $$ = -1;}
+	| 	{$$ = -1;}
+	;
+
 max_locals_decl:
 	MAX_LOCALS INTCONSTANT
 		{$$ = $2;}
+	| MAX_LOCALS IDENTIFIER
+		{ if (strcmp($2, "auto") != 0)
+		     oops("max_locals must be a number or auto.");
+		  $$ = -1;}
 	| 	{$$ = -1;}
 	;
 
@@ -751,13 +766,20 @@ op_list	: op_list op_line
        		{break;}
 	;
 
-op_line	: label op
+op_line	: labels op
        		{break;}
 	| op
        		{break;}
 	| localvar
        		{break;}
-	| label localvar
+	| labels localvar
+       		{break;}
+	;
+
+/* several labels can name the same instruction */
+labels	: label
+       		{break;}
+	| labels label
        		{break;}
 	;
 
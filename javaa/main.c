@@ -1,6 +1,7 @@
 /* copyright 1996 Jason Hunt and Washington University, St. Louis */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "types.h"
 #include "protos.h"
 #include "listing.h"
@@ -10,11 +11,17 @@ extern int UseStdOut;
 extern FILE *yyin;
 main(int argc, char *argv[]){
   int result;
-  if (argc == 1) {
-    fprintf(stderr, "Usage: javaa filename\n");
+  if (argc > 2) {
+    fprintf(stderr, "Usage: javaa [filename | -]\n");
+    exit(1);
+  }
+  /* no file, or -, is standard input, as in parser -o - prog.sd | javaa - */
+  if (argc == 1 || strcmp(argv[1], "-") == 0) {
+    yyin = stdin;
+  } else if ((yyin = fopen(argv[1], "r")) == NULL) {
+    perror(argv[1]);
     exit(1);
   }
-  yyin = fopen(argv[1], "r"); 
   UseStdOut = 0;
   /* yydebug = 1; */
   StartListing();
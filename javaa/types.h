@@ -54,17 +54,20 @@ typedef
    }
 ;
 
+/* bytes of a class file being built in memory */
 typedef
-   struct methodname{
-      char name[L_tmpnam];
-      methodname* next;
+   struct {
+      char* bytes;
+      int length;
+      int size;  /* bytes allocated */
    }
-;
+ByteBuffer;
 
 typedef
    struct unresolvedindex{
       long location;
       long opcodelocation;
+      int size;  /* 2 or 4 byte offset */
       unresolvedindex* next;
    }
 ;
@@ -73,24 +76,26 @@ typedef
 */
 typedef
    struct {
-      short int myindex;
+      int myindex;
       char consttype;
-      short int index1;
-      short int index2;
+      int index1;
+      int index2;
       char* stringval;
       long int intval;  
       float floatval;
       long long int longval;
       /*long int longval2;*/
       double doubleval;
+      int hashnext;  /* next array slot in the same hash bucket, 0 if none */
    }
-ConstPoolEntry; 
+ConstPoolEntry;
 
 typedef
    struct {
       char* name;
       long index;
       unresolvedindex* unresolvedindexhead;
+      int hashnext;  /* next label in the same hash bucket, -1 if none */
    }
 LabelInfo;
 
@@ -127,6 +132,19 @@ typedef
    }
 ;
 
+/* an instruction that refers to labels, kept so that EndMethod can
+   relax branches whose offsets turn out not to fit in 2 bytes */
+typedef
+   struct {
+      long location;    /* of the opcode in Code */
+      int length;       /* bytes the instruction takes in Code */
+      char kind;        /* BRANCHSITE, WIDEBRANCHSITE or SWITCHSITE */
+      char widened;     /* a short branch that has to be widened */
+      int labelptr;     /* the branch target */
+      int firsttarget;  /* for a switch, its labels in SwitchTarget */
+   }
+BranchSite;
+
 typedef
    struct {
       short access_flags;
@@ -134,13 +152,24 @@ typedef
       short signature_index;
       short max_stack;
       short max_locals;
-      char Code[65535];
+      char* Code;
+      int CodeSize;  /* bytes allocated for Code */
       unsigned short CodeCounter;
-      LabelInfo Label[100];
-      short LabelCounter;
-      LocalVarInfo LocalVar[256];
-      short LocalVarCounter;
-      short currentslot;
+      LabelInfo* Label;
+      int LabelSize;  /* entries allocated for Label */
+      int LabelCounter;
+      int* LabelHash;
+      int LabelHashSize;
+      BranchSite* Site;
+      int SiteSize;  /* entries allocated for Site */
+      int SiteCounter;
+      int* SwitchTarget;  /* label indexes used by the switches */
+      int SwitchTargetSize;
+      int SwitchTargetCounter;
+      LocalVarInfo* LocalVar;
+      int LocalVarSize;  /* entries allocated for LocalVar */
+      int LocalVarCounter;
+      int currentslot;
       short ExceptionsCounter;
       exceptionentry* exceptionhead;
       short ThrowsCounter;
@@ -159,7 +188,7 @@ typedef
       char* classname;
       short superclassindex;
       char* superclassname;
-      short interfacecount;
+      int interfacecount;
       interfaceentry* interfacehead;
       short sourcefileindex;
    }
@@ -0,0 +1,483 @@
+#ifndef OPCODE_TABLE_H
+#define OPCODE_TABLE_H
+
+#include <stddef.h>
+
+// JVM instruction set shared by the compiler's CodeGenerator and the javaa
+// assembler (javaa/gen.c).  JvmOpTable is indexed by the opcode byte, so
+// every lookup is a single array access and nothing is built at startup.
+// Mnemonics are spelled the way javaa reads them.
+
+#define JVM_OPCODE_COUNT 202
+#define JVM_VARIABLE -1     // length or stack effect depends on the operands
+
+typedef enum JvmOpcode {
+    OP_NOP = 0,
+    OP_ACONST_NULL = 1,
+    OP_ICONST_M1 = 2,
+    OP_ICONST_0 = 3,
+    OP_ICONST_1 = 4,
+    OP_ICONST_2 = 5,
+    OP_ICONST_3 = 6,
+    OP_ICONST_4 = 7,
+    OP_ICONST_5 = 8,
+    OP_LCONST_0 = 9,
+    OP_LCONST_1 = 10,
+    OP_FCONST_0 = 11,
+    OP_FCONST_1 = 12,
+    OP_FCONST_2 = 13,
+    OP_DCONST_0 = 14,
+    OP_DCONST_1 = 15,
+    OP_BIPUSH = 16,
+    OP_SIPUSH = 17,
+    OP_LDC = 18,
+    OP_LDC_W = 19,
+    OP_LDC2_W = 20,
+    OP_ILOAD = 21,
+    OP_LLOAD = 22,
+    OP_FLOAD = 23,
+    OP_DLOAD = 24,
+    OP_ALOAD = 25,
+    OP_ILOAD_0 = 26,
+    OP_ILOAD_1 = 27,
+    OP_ILOAD_2 = 28,
+    OP_ILOAD_3 = 29,
+    OP_LLOAD_0 = 30,
+    OP_LLOAD_1 = 31,
+    OP_LLOAD_2 = 32,
+    OP_LLOAD_3 = 33,
+    OP_FLOAD_0 = 34,
+    OP_FLOAD_1 = 35,
+    OP_FLOAD_2 = 36,
+    OP_FLOAD_3 = 37,
+    OP_DLOAD_0 = 38,
+    OP_DLOAD_1 = 39,
+    OP_DLOAD_2 = 40,
+    OP_DLOAD_3 = 41,
+    OP_ALOAD_0 = 42,
+    OP_ALOAD_1 = 43,
+    OP_ALOAD_2 = 44,
+    OP_ALOAD_3 = 45,
+    OP_IALOAD = 46,
+    OP_LALOAD = 47,
+    OP_FALOAD = 48,
+    OP_DALOAD = 49,
+    OP_AALOAD = 50,
+    OP_BALOAD = 51,
+    OP_CALOAD = 52,
+    OP_SALOAD = 53,
+    OP_ISTORE = 54,
+    OP_LSTORE = 55,
+    OP_FSTORE = 56,
+    OP_DSTORE = 57,
+    OP_ASTORE = 58,
+    OP_ISTORE_0 = 59,
+    OP_ISTORE_1 = 60,
+    OP_ISTORE_2 = 61,
+    OP_ISTORE_3 = 62,
+    OP_LSTORE_0 = 63,
+    OP_LSTORE_1 = 64,
+    OP_LSTORE_2 = 65,
+    OP_LSTORE_3 = 66,
+    OP_FSTORE_0 = 67,
+    OP_FSTORE_1 = 68,
+    OP_FSTORE_2 = 69,
+    OP_FSTORE_3 = 70,
+    OP_DSTORE_0 = 71,
+    OP_DSTORE_1 = 72,
+    OP_DSTORE_2 = 73,
+    OP_DSTORE_3 = 74,
+    OP_ASTORE_0 = 75,
+    OP_ASTORE_1 = 76,
+    OP_ASTORE_2 = 77,
+    OP_ASTORE_3 = 78,
+    OP_IASTORE = 79,
+    OP_LASTORE = 80,
+    OP_FASTORE = 81,
+    OP_DASTORE = 82,
+    OP_AASTORE = 83,
+    OP_BASTORE = 84,
+    OP_CASTORE = 85,
+    OP_SASTORE = 86,
+    OP_POP = 87,
+    OP_POP2 = 88,
+    OP_DUP = 89,
+    OP_DUP_X1 = 90,
+    OP_DUP_X2 = 91,
+    OP_DUP2 = 92,
+    OP_DUP2_X1 = 93,
+    OP_DUP2_X2 = 94,
+    OP_SWAP = 95,
+    OP_IADD = 96,
+    OP_LADD = 97,
+    OP_FADD = 98,
+    OP_DADD = 99,
+    OP_ISUB = 100,
+    OP_LSUB = 101,
+    OP_FSUB = 102,
+    OP_DSUB = 103,
+    OP_IMUL = 104,
+    OP_LMUL = 105,
+    OP_FMUL = 106,
+    OP_DMUL = 107,
+    OP_IDIV = 108,
+    OP_LDIV = 109,
+    OP_FDIV = 110,
+    OP_DDIV = 111,
+    OP_IREM = 112,
+    OP_LREM = 113,
+    OP_FREM = 114,
+    OP_DREM = 115,
+    OP_INEG = 116,
+    OP_LNEG = 117,
+    OP_FNEG = 118,
+    OP_DNEG = 119,
+    OP_ISHL = 120,
+    OP_LSHL = 121,
+    OP_ISHR = 122,
+    OP_LSHR = 123,
+    OP_IUSHR = 124,
+    OP_LUSHR = 125,
+    OP_IAND = 126,
+    OP_LAND = 127,
+    OP_IOR = 128,
+    OP_LOR = 129,
+    OP_IXOR = 130,
+    OP_LXOR = 131,
+    OP_IINC = 132,
+    OP_I2L = 133,
+    OP_I2F = 134,
+    OP_I2D = 135,
+    OP_L2I = 136,
+    OP_L2F = 137,
+    OP_L2D = 138,
+    OP_F2I = 139,
+    OP_F2L = 140,
+    OP_F2D = 141,
+    OP_D2I = 142,
+    OP_D2L = 143,
+    OP_D2F = 144,
+    OP_I2B = 145,
+    OP_I2C = 146,
+    OP_I2S = 147,
+    OP_LCMP = 148,
+    OP_FCMPL = 149,
+    OP_FCMPG = 150,
+    OP_DCMPL = 151,
+    OP_DCMPG = 152,
+    OP_IFEQ = 153,
+    OP_IFNE = 154,
+    OP_IFLT = 155,
+    OP_IFGE = 156,
+    OP_IFGT = 157,
+    OP_IFLE = 158,
+    OP_IF_ICMPEQ = 159,
+    OP_IF_ICMPNE = 160,
+    OP_IF_ICMPLT = 161,
+    OP_IF_ICMPGE = 162,
+    OP_IF_ICMPGT = 163,
+    OP_IF_ICMPLE = 164,
+    OP_IF_ACMPEQ = 165,
+    OP_IF_ACMPNE = 166,
+    OP_GOTO = 167,
+    OP_JSR = 168,
+    OP_RET = 169,
+    OP_TABLESWITCH = 170,
+    OP_LOOKUPSWITCH = 171,
+    OP_IRETURN = 172,
+    OP_LRETURN = 173,
+    OP_FRETURN = 174,
+    OP_DRETURN = 175,
+    OP_ARETURN = 176,
+    OP_RETURN = 177,
+    OP_GETSTATIC = 178,
+    OP_PUTSTATIC = 179,
+    OP_GETFIELD = 180,
+    OP_PUTFIELD = 181,
+    OP_INVOKEVIRTUAL = 182,
+    OP_INVOKENONVIRTUAL = 183,
+    OP_INVOKESTATIC = 184,
+    OP_INVOKEINTERFACE = 185,
+    OP_NEW = 187,
+    OP_NEWARRAY = 188,
+    OP_ANEWARRAY = 189,
+    OP_ARRAYLENGTH = 190,
+    OP_ATHROW = 191,
+    OP_CHECKCAST = 192,
+    OP_INSTANCEOF = 193,
+    OP_MONITORENTER = 194,
+    OP_MONITOREXIT = 195,
+    OP_WIDE = 196,
+    OP_MULTIANEWARRAY = 197,
+    OP_IFNULL = 198,
+    OP_IFNONNULL = 199,
+    OP_GOTO_W = 200,
+    OP_JSR_W = 201,
+} JvmOpcode;
+
+// how the bytes after the opcode are laid out
+typedef enum JvmOperands {
+    OPERANDS_NONE,
+    OPERANDS_BYTE,              // s1 immediate (bipush)
+    OPERANDS_SHORT,             // s2 immediate (sipush)
+    OPERANDS_CONST1,            // u1 constant pool index (ldc)
+    OPERANDS_CONST2,            // u2 constant pool index
+    OPERANDS_LOCAL,             // u1 local variable slot
+    OPERANDS_IINC,              // u1 slot, s1 increment
+    OPERANDS_BRANCH2,           // s2 branch offset
+    OPERANDS_BRANCH4,           // s4 branch offset
+    OPERANDS_NEWARRAY,          // u1 array element type
+    OPERANDS_INVOKEINTERFACE,   // u2 index, u1 nargs, u1 zero
+    OPERANDS_MULTIANEWARRAY,    // u2 index, u1 dimensions
+    OPERANDS_TABLESWITCH,       // padding, then s4 default, low, high, offsets
+    OPERANDS_LOOKUPSWITCH,      // padding, then s4 default, npairs, pairs
+    OPERANDS_WIDE               // opcode, then a u2 slot (and s2 for iinc)
+} JvmOperands;
+
+typedef struct JvmOpInfo {
+    const char *mnemonic;       // NULL for the unused opcode 186
+    unsigned char byteval;
+    JvmOperands operands;
+    signed char length;         // bytes including the opcode
+    signed char pops;           // stack words, 2 for longs and doubles
+    signed char pushes;
+} JvmOpInfo;
+
+constexpr JvmOpInfo JvmOpTable[JVM_OPCODE_COUNT] = {
+    // mnemonic            byte  operands                  length        pops          pushes
+    { "nop",                 0, OPERANDS_NONE,             1,            0,            0 },
+    { "aconst_null",         1, OPERANDS_NONE,             1,            0,            1 },
+    { "iconst_m1",           2, OPERANDS_NONE,             1,            0,            1 },
+    { "iconst_0",            3, OPERANDS_NONE,             1,            0,            1 },
+    { "iconst_1",            4, OPERANDS_NONE,             1,            0,            1 },
+    { "iconst_2",            5, OPERANDS_NONE,             1,            0,            1 },
+    { "iconst_3",            6, OPERANDS_NONE,             1,            0,            1 },
+    { "iconst_4",            7, OPERANDS_NONE,             1,            0,            1 },
+    { "iconst_5",            8, OPERANDS_NONE,             1,            0,            1 },
+    { "lconst_0",            9, OPERANDS_NONE,             1,            0,            2 },
+    { "lconst_1",           10, OPERANDS_NONE,             1,            0,            2 },
+    { "fconst_0",           11, OPERANDS_NONE,             1,            0,            1 },
+    { "fconst_1",           12, OPERANDS_NONE,             1,            0,            1 },
+    { "fconst_2",           13, OPERANDS_NONE,             1,            0,            1 },
+    { "dconst_0",           14, OPERANDS_NONE,             1,            0,            2 },
+    { "dconst_1",           15, OPERANDS_NONE,             1,            0,            2 },
+    { "bipush",             16, OPERANDS_BYTE,             2,            0,            1 },
+    { "sipush",             17, OPERANDS_SHORT,            3,            0,            1 },
+    { "ldc",                18, OPERANDS_CONST1,           2,            0,            1 },
+    { "ldc_w",              19, OPERANDS_CONST2,           3,            0,            1 },
+    { "ldc2_w",             20, OPERANDS_CONST2,           3,            0,            2 },
+    { "iload",              21, OPERANDS_LOCAL,            2,            0,            1 },
+    { "lload",              22, OPERANDS_LOCAL,            2,            0,            2 },
+    { "fload",              23, OPERANDS_LOCAL,            2,            0,            1 },
+    { "dload",              24, OPERANDS_LOCAL,            2,            0,            2 },
+    { "aload",              25, OPERANDS_LOCAL,            2,            0,            1 },
+    { "iload_0",            26, OPERANDS_NONE,             1,            0,            1 },
+    { "iload_1",            27, OPERANDS_NONE,             1,            0,            1 },
+    { "iload_2",            28, OPERANDS_NONE,             1,            0,            1 },
+    { "iload_3",            29, OPERANDS_NONE,             1,            0,            1 },
+    { "lload_0",            30, OPERANDS_NONE,             1,            0,            2 },
+    { "lload_1",            31, OPERANDS_NONE,             1,            0,            2 },
+    { "lload_2",            32, OPERANDS_NONE,             1,            0,            2 },
+    { "lload_3",            33, OPERANDS_NONE,             1,            0,            2 },
+    { "fload_0",            34, OPERANDS_NONE,             1,            0,            1 },
+    { "fload_1",            35, OPERANDS_NONE,             1,            0,            1 },
+    { "fload_2",            36, OPERANDS_NONE,             1,            0,            1 },
+    { "fload_3",            37, OPERANDS_NONE,             1,            0,            1 },
+    { "dload_0",            38, OPERANDS_NONE,             1,            0,            2 },
+    { "dload_1",            39, OPERANDS_NONE,             1,            0,            2 },
+    { "dload_2",            40, OPERANDS_NONE,             1,            0,            2 },
+    { "dload_3",            41, OPERANDS_NONE,             1,            0,            2 },
+    { "aload_0",            42, OPERANDS_NONE,             1,            0,            1 },
+    { "aload_1",            43, OPERANDS_NONE,             1,            0,            1 },
+    { "aload_2",            44, OPERANDS_NONE,             1,            0,            1 },
+    { "aload_3",            45, OPERANDS_NONE,             1,            0,            1 },
+    { "iaload",             46, OPERANDS_NONE,             1,            2,            1 },
+    { "laload",             47, OPERANDS_NONE,             1,            2,            2 },
+    { "faload",             48, OPERANDS_NONE,             1,            2,            1 },
+    { "daload",             49, OPERANDS_NONE,             1,            2,            2 },
+    { "aaload",             50, OPERANDS_NONE,             1,            2,            1 },
+    { "baload",             51, OPERANDS_NONE,             1,            2,            1 },
+    { "caload",             52, OPERANDS_NONE,             1,            2,            1 },
+    { "saload",             53, OPERANDS_NONE,             1,            2,            1 },
+    { "istore",             54, OPERANDS_LOCAL,            2,            1,            0 },
+    { "lstore",             55, OPERANDS_LOCAL,            2,            2,            0 },
+    { "fstore",             56, OPERANDS_LOCAL,            2,            1,            0 },
+    { "dstore",             57, OPERANDS_LOCAL,            2,            2,            0 },
+    { "astore",             58, OPERANDS_LOCAL,            2,            1,            0 },
+    { "istore_0",           59, OPERANDS_NONE,             1,            1,            0 },
+    { "istore_1",           60, OPERANDS_NONE,             1,            1,            0 },
+    { "istore_2",           61, OPERANDS_NONE,             1,            1,            0 },
+    { "istore_3",           62, OPERANDS_NONE,             1,            1,            0 },
+    { "lstore_0",           63, OPERANDS_NONE,             1,            2,            0 },
+    { "lstore_1",           64, OPERANDS_NONE,             1,            2,            0 },
+    { "lstore_2",           65, OPERANDS_NONE,             1,            2,            0 },
+    { "lstore_3",           66, OPERANDS_NONE,             1,            2,            0 },
+    { "fstore_0",           67, OPERANDS_NONE,             1,            1,            0 },
+    { "fstore_1",           68, OPERANDS_NONE,             1,            1,            0 },
+    { "fstore_2",           69, OPERANDS_NONE,             1,            1,            0 },
+    { "fstore_3",           70, OPERANDS_NONE,             1,            1,            0 },
+    { "dstore_0",           71, OPERANDS_NONE,             1,            2,            0 },
+    { "dstore_1",           72, OPERANDS_NONE,             1,            2,            0 },
+    { "dstore_2",           73, OPERANDS_NONE,             1,            2,            0 },
+    { "dstore_3",           74, OPERANDS_NONE,             1,            2,            0 },
+    { "astore_0",           75, OPERANDS_NONE,             1,            1,            0 },
+    { "astore_1",           76, OPERANDS_NONE,             1,            1,            0 },
+    { "astore_2",           77, OPERANDS_NONE,             1,            1,            0 },
+    { "astore_3",           78, OPERANDS_NONE,             1,            1,            0 },
+    { "iastore",            79, OPERANDS_NONE,             1,            3,            0 },
+    { "lastore",            80, OPERANDS_NONE,             1,            4,            0 },
+    { "fastore",            81, OPERANDS_NONE,             1,            3,            0 },
+    { "dastore",            82, OPERANDS_NONE,             1,            4,            0 },
+    { "aastore",            83, OPERANDS_NONE,             1,            3,            0 },
+    { "bastore",            84, OPERANDS_NONE,             1,            3,            0 },
+    { "castore",            85, OPERANDS_NONE,             1,            3,            0 },
+    { "sastore",            86, OPERANDS_NONE,             1,            3,            0 },
+    { "pop",                87, OPERANDS_NONE,             1,            1,            0 },
+    { "pop2",               88, OPERANDS_NONE,             1,            2,            0 },
+    { "dup",                89, OPERANDS_NONE,             1,            1,            2 },
+    { "dup_x1",             90, OPERANDS_NONE,             1,            2,            3 },
+    { "dup_x2",             91, OPERANDS_NONE,             1,            3,            4 },
+    { "dup2",               92, OPERANDS_NONE,             1,            2,            4 },
+    { "dup2_x1",            93, OPERANDS_NONE,             1,            3,            5 },
+    { "dup2_x2",            94, OPERANDS_NONE,             1,            4,            6 },
+    { "swap",               95, OPERANDS_NONE,             1,            2,            2 },
+    { "iadd",               96, OPERANDS_NONE,             1,            2,            1 },
+    { "ladd",               97, OPERANDS_NONE,             1,            4,            2 },
+    { "fadd",               98, OPERANDS_NONE,             1,            2,            1 },
+    { "dadd",               99, OPERANDS_NONE,             1,            4,            2 },
+    { "isub",              100, OPERANDS_NONE,             1,            2,            1 },
+    { "lsub",              101, OPERANDS_NONE,             1,            4,            2 },
+    { "fsub",              102, OPERANDS_NONE,             1,            2,            1 },
+    { "dsub",              103, OPERANDS_NONE,             1,            4,            2 },
+    { "imul",              104, OPERANDS_NONE,             1,            2,            1 },
+    { "lmul",              105, OPERANDS_NONE,             1,            4,            2 },
+    { "fmul",              106, OPERANDS_NONE,             1,            2,            1 },
+    { "dmul",              107, OPERANDS_NONE,             1,            4,            2 },
+    { "idiv",              108, OPERANDS_NONE,             1,            2,            1 },
+    { "ldiv",              109, OPERANDS_NONE,             1,            4,            2 },
+    { "fdiv",              110, OPERANDS_NONE,             1,            2,            1 },
+    { "ddiv",              111, OPERANDS_NONE,             1,            4,            2 },
+    { "irem",              112, OPERANDS_NONE,             1,            2,            1 },
+    { "lrem",              113, OPERANDS_NONE,             1,            4,            2 },
+    { "frem",              114, OPERANDS_NONE,             1,            2,            1 },
+    { "drem",              115, OPERANDS_NONE,             1,            4,            2 },
+    { "ineg",              116, OPERANDS_NONE,             1,            1,            1 },
+    { "lneg",              117, OPERANDS_NONE,             1,            2,            2 },
+    { "fneg",              118, OPERANDS_NONE,             1,            1,            1 },
+    { "dneg",              119, OPERANDS_NONE,             1,            2,            2 },
+    { "ishl",              120, OPERANDS_NONE,             1,            2,            1 },
+    { "lshl",              121, OPERANDS_NONE,             1,            3,            2 },
+    { "ishr",              122, OPERANDS_NONE,             1,            2,            1 },
+    { "lshr",              123, OPERANDS_NONE,             1,            3,            2 },
+    { "iushr",             124, OPERANDS_NONE,             1,            2,            1 },
+    { "lushr",             125, OPERANDS_NONE,             1,            3,            2 },
+    { "iand",              126, OPERANDS_NONE,             1,            2,            1 },
+    { "land",              127, OPERANDS_NONE,             1,            4,            2 },
+    { "ior",               128, OPERANDS_NONE,             1,            2,            1 },
+    { "lor",               129, OPERANDS_NONE,             1,            4,            2 },
+    { "ixor",              130, OPERANDS_NONE,             1,            2,            1 },
+    { "lxor",              131, OPERANDS_NONE,             1,            4,            2 },
+    { "iinc",              132, OPERANDS_IINC,             3,            0,            0 },
+    { "i2l",               133, OPERANDS_NONE,             1,            1,            2 },
+    { "i2f",               134, OPERANDS_NONE,             1,            1,            1 },
+    { "i2d",               135, OPERANDS_NONE,             1,            1,            2 },
+    { "l2i",               136, OPERANDS_NONE,             1,            2,            1 },
+    { "l2f",               137, OPERANDS_NONE,             1,            2,            1 },
+    { "l2d",               138, OPERANDS_NONE,             1,            2,            2 },
+    { "f2i",               139, OPERANDS_NONE,             1,            1,            1 },
+    { "f2l",               140, OPERANDS_NONE,             1,            1,            2 },
+    { "f2d",               141, OPERANDS_NONE,             1,            1,            2 },
+    { "d2i",               142, OPERANDS_NONE,             1,            2,            1 },
+    { "d2l",               143, OPERANDS_NONE,             1,            2,            2 },
+    { "d2f",               144, OPERANDS_NONE,             1,            2,            1 },
+    { "i2b",               145, OPERANDS_NONE,             1,            1,            1 },
+    { "i2c",               146, OPERANDS_NONE,             1,            1,            1 },
+    { "i2s",               147, OPERANDS_NONE,             1,            1,            1 },
+    { "lcmp",              148, OPERANDS_NONE,             1,            4,            1 },
+    { "fcmpl",             149, OPERANDS_NONE,             1,            2,            1 },
+    { "fcmpg",             150, OPERANDS_NONE,             1,            2,            1 },
+    { "dcmpl",             151, OPERANDS_NONE,             1,            4,            1 },
+    { "dcmpg",             152, OPERANDS_NONE,             1,            4,            1 },
+    { "ifeq",              153, OPERANDS_BRANCH2,          3,            1,            0 },
+    { "ifne",              154, OPERANDS_BRANCH2,          3,            1,            0 },
+    { "iflt",              155, OPERANDS_BRANCH2,          3,            1,            0 },
+    { "ifge",              156, OPERANDS_BRANCH2,          3,            1,            0 },
+    { "ifgt",              157, OPERANDS_BRANCH2,          3,            1,            0 },
+    { "ifle",              158, OPERANDS_BRANCH2,          3,            1,            0 },
+    { "if_icmpeq",         159, OPERANDS_BRANCH2,          3,            2,            0 },
+    { "if_icmpne",         160, OPERANDS_BRANCH2,          3,            2,            0 },
+    { "if_icmplt",         161, OPERANDS_BRANCH2,          3,            2,            0 },
+    { "if_icmpge",         162, OPERANDS_BRANCH2,          3,            2,            0 },
+    { "if_icmpgt",         163, OPERANDS_BRANCH2,          3,            2,            0 },
+    { "if_icmple",         164, OPERANDS_BRANCH2,          3,            2,            0 },
+    { "if_acmpeq",         165, OPERANDS_BRANCH2,          3,            2,            0 },
+    { "if_acmpne",         166, OPERANDS_BRANCH2,          3,            2,            0 },
+    { "goto",              167, OPERANDS_BRANCH2,          3,            0,            0 },
+    { "jsr",               168, OPERANDS_BRANCH2,          3,            0,            1 },
+    { "ret",               169, OPERANDS_LOCAL,            2,            0,            0 },
+    { "tableswitch",       170, OPERANDS_TABLESWITCH,      JVM_VARIABLE, 1,            0 },
+    { "lookupswitch",      171, OPERANDS_LOOKUPSWITCH,     JVM_VARIABLE, 1,            0 },
+    { "ireturn",           172, OPERANDS_NONE,             1,            1,            0 },
+    { "lreturn",           173, OPERANDS_NONE,             1,            2,            0 },
+    { "freturn",           174, OPERANDS_NONE,             1,            1,            0 },
+    { "dreturn",           175, OPERANDS_NONE,             1,            2,            0 },
+    { "areturn",           176, OPERANDS_NONE,             1,            1,            0 },
+    { "return",            177, OPERANDS_NONE,             1,            0,            0 },
+    { "getstatic",         178, OPERANDS_CONST2,           3,            JVM_VARIABLE, JVM_VARIABLE },
+    { "putstatic",         179, OPERANDS_CONST2,           3,            JVM_VARIABLE, JVM_VARIABLE },
+    { "getfield",          180, OPERANDS_CONST2,           3,            JVM_VARIABLE, JVM_VARIABLE },
+    { "putfield",          181, OPERANDS_CONST2,           3,            JVM_VARIABLE, JVM_VARIABLE },
+    { "invokevirtual",     182, OPERANDS_CONST2,           3,            JVM_VARIABLE, JVM_VARIABLE },
+    { "invokenonvirtual",  183, OPERANDS_CONST2,           3,            JVM_VARIABLE, JVM_VARIABLE },
+    { "invokestatic",      184, OPERANDS_CONST2,           3,            JVM_VARIABLE, JVM_VARIABLE },
+    { "invokeinterface",   185, OPERANDS_INVOKEINTERFACE,  5,            JVM_VARIABLE, JVM_VARIABLE },
+    { NULL,                186, OPERANDS_NONE,             1,            0,            0 },
+    { "new",               187, OPERANDS_CONST2,           3,            0,            1 },
+    { "newarray",          188, OPERANDS_NEWARRAY,         2,            1,            1 },
+    { "anewarray",         189, OPERANDS_CONST2,           3,            1,            1 },
+    { "arraylength",       190, OPERANDS_NONE,             1,            1,            1 },
+    { "athrow",            191, OPERANDS_NONE,             1,            1,            0 },
+    { "checkcast",         192, OPERANDS_CONST2,           3,            1,            1 },
+    { "instanceof",        193, OPERANDS_CONST2,           3,            1,            1 },
+    { "monitorenter",      194, OPERANDS_NONE,             1,            1,            0 },
+    { "monitorexit",       195, OPERANDS_NONE,             1,            1,            0 },
+    { "wide",              196, OPERANDS_WIDE,             JVM_VARIABLE, JVM_VARIABLE, JVM_VARIABLE },
+    { "multianewarray",    197, OPERANDS_MULTIANEWARRAY,   4,            JVM_VARIABLE, 1 },
+    { "ifnull",            198, OPERANDS_BRANCH2,          3,            1,            0 },
+    { "ifnonnull",         199, OPERANDS_BRANCH2,          3,            1,            0 },
+    { "goto_w",            200, OPERANDS_BRANCH4,          5,            0,            0 },
+    { "jsr_w",             201, OPERANDS_BRANCH4,          5,            0,            1 }
+};
+
+constexpr bool JvmOpTableInOrder(int i = 0) {
+    return i == JVM_OPCODE_COUNT ||
+           (JvmOpTable[i].byteval == i && JvmOpTableInOrder(i + 1));
+}
+static_assert(JvmOpTableInOrder(), "JvmOpTable must be indexed by opcode");
+
+constexpr const JvmOpInfo &JvmOp(int opcode) {
+    return JvmOpTable[opcode];
+}
+
+// true for the instructions whose operand is a single branch offset
+constexpr bool JvmIsBranch(int opcode) {
+    return JvmOpTable[opcode].operands == OPERANDS_BRANCH2 ||
+           JvmOpTable[opcode].operands == OPERANDS_BRANCH4;
+}
+
+// the conditional branch taken in exactly the cases the given one is not
+// (ifeq <-> ifne, if_icmplt <-> if_icmpge, ifnull <-> ifnonnull, ...), or
+// -1 for an unconditional branch or a non-branch
+constexpr int JvmInvertBranch(int opcode) {
+    return (opcode >= OP_IFEQ && opcode <= OP_IF_ACMPNE)
+               ? ((opcode - OP_IFEQ) ^ 1) + OP_IFEQ
+           : (opcode == OP_IFNULL) ? OP_IFNONNULL
+           : (opcode == OP_IFNONNULL) ? OP_IFNULL
+           : -1;
+}
+static_assert(JvmInvertBranch(OP_IFLT) == OP_IFGE &&
+              JvmInvertBranch(OP_IF_ICMPLE) == OP_IF_ICMPGT &&
+              JvmInvertBranch(OP_IF_ACMPNE) == OP_IF_ACMPEQ,
+              "branch inversion pairs");
+
+#endif
@@ -3,77 +3,688 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
 
 #include "symbol_table.h"
 #include "function_table.h"
 #include "expr_value.h"
+#include "compile_context.h"
 
 #include "code_generation.h"
+#include "batch.h"
 
-// get token that recognized by scanner
-extern int yylex();
-extern int yyparse();
-extern FILE *yyin;
-extern char *yytext;
-extern int linenum;
-
-SymbolTable *currentTable = NULL;
-FunctionTable *functionTable = NULL;
-
-CodeGenerator *codeGen = NULL;
-
-// Helper variables for function return type checking
-char *current_function_name_for_return_check = NULL;
-char *current_function_return_type_for_return_check = NULL; // Stores "int", "float", "void", etc.
-bool non_void_function_has_return_value_statement = false; // True if a 'return <expr>;' was found and type-checked
+// the reentrant scanner's interface (yyscan_t is a void *)
+int yylex_init_extra(CompileContext *extra, void **scanner);
+struct yy_buffer_state *yy_scan_buffer(char *base, size_t size, void *scanner);
+int yylex_destroy(void *scanner);
+// puts back the character the scanner replaced with a NUL after the token
+void restoreTokenEnd(void *scanner);
 
 // Helper function to create a default error expression value
 static inline ExprValue default_expr_error_value() {
     ExprValue res;
-    res.type = "ERROR"; 
-    res.value = NULL;   
+    memset(&res, 0, sizeof(res)); // TYPE_ERROR, value unknown
+    return res;
+}
+
+// The last token scanned, which a diagnostic points at
+static const TokenSpan *lastToken(CompileContext *ctx) {
+    return ctx->tokens.count > 0 ? &ctx->tokens.spans[ctx->tokens.count - 1] : NULL;
+}
+
+void yyerror(CompileContext *ctx, const char *s) {
+    restoreTokenEnd(ctx->scanner);
+    reportMessage(&ctx->diag, DIAG_ERROR, ctx->linenum, lastToken(ctx), s);
+}
+
+// called by the parser itself for syntax errors
+void yyerror(void *, CompileContext *ctx, const char *s) {
+    yyerror(ctx, s);
+}
+
+void yywarning(CompileContext *ctx, const char *s) {
+    restoreTokenEnd(ctx->scanner);
+    reportMessage(&ctx->diag, DIAG_WARNING, ctx->linenum, lastToken(ctx), s);
+}
+
+// A string literal's text without its quotes and with each "" turned
+// into ", copied out of the source
+static const char *unquoteString(CompileContext *ctx, Span span) {
+    const char *in = spanText(&ctx->source, span) + 1;
+    const char *end = in + span.length - 2;
+    char *text = (char *)arenaAlloc(ctx->arena, end - in + 1);
+    char *out = text;
+    for (; in < end; in++) {
+        *out++ = *in;
+        if (in[0] == '"') in++; // the second quote of ""
+    }
+    *out = '\0';
+    return text;
+}
+
+// The initial value of a field as javaa reads it, or "" if it is not a
+// compile-time constant
+static std::string fieldInitializer(const ExprValue &value) {
+    if (!value.known) return "";
+    switch (value.type) {
+        case TYPE_INT: return std::to_string(value.intValue);
+        case TYPE_REAL: return realLiteral(value.realValue);
+        case TYPE_BOOL: return value.boolValue ? "true" : "false";
+        case TYPE_STRING: return "\"" + std::string(value.stringValue) + "\"";
+        default: return "";
+    }
+}
+
+// the ExprType of an interned type name, TYPE_ERROR for other names
+static inline ExprType exprTypeOf(const Name *typeName) {
+    return (ExprType)typeName->tag;
+}
+
+static float realOf(ExprValue v) {
+    return v.type == TYPE_INT ? (float)v.intValue : v.realValue;
+}
+
+// f2i as the JVM does it: NaN is 0 and the rest saturates
+static int intOfReal(float v) {
+    if (v != v) return 0;
+    if (v >= 2147483648.0f) return INT_MAX;
+    if (v <= -2147483648.0f) return INT_MIN;
+    return (int)v;
+}
+
+// whether the value's code has left it on the stack
+static bool onStack(ExprValue value) {
+    return !value.known && value.type != TYPE_ERROR && value.type != TYPE_VOID;
+}
+
+static void placeLabel(CompileContext *ctx, int label) {
+    if (label != 0) {
+        ctx->codeGen->emitLabel(label);
+    }
+}
+
+// A bool computed onto the stack, as a condition: true when it is nonzero
+static ExprValue asCondition(ExprValue value) {
+    if (value.branch == OP_NOP) {
+        value.branch = OP_IFNE;
+        value.testsBool = true;
+    }
+    return value;
+}
+
+// A condition made into a bool on the stack.  A bare ifne of a bool is
+// that bool already, and a bare ifeq is one xor away from it; anything
+// else, a comparison's result included, is branched on.
+static ExprValue settleCondition(CompileContext *ctx, ExprValue value) {
+    if (value.branch == OP_NOP) return value;
+    CodeGenerator *codeGen = ctx->codeGen;
+    bool bare = value.testsBool && value.trueLabel == 0 && value.falseLabel == 0;
+    if (bare && value.branch == OP_IFNE) {
+        // nothing to do
+    } else if (bare && value.branch == OP_IFEQ) {
+        codeGen->emitInstruction(OP_ICONST_1);
+        codeGen->emitInstruction(OP_IXOR);
+    } else {
+        int isTrue = codeGen->joinLabels(codeGen->newLabel(), value.trueLabel);
+        int done = codeGen->newLabel();
+        codeGen->emitBranch(value.branch, isTrue);
+        placeLabel(ctx, value.falseLabel);
+        codeGen->emitConstant(0);
+        codeGen->emitBranch(OP_GOTO, done);
+        codeGen->emitLabel(isTrue);
+        codeGen->emitConstant(1);
+        codeGen->emitLabel(done);
+    }
+    value.branch = OP_NOP;
+    value.testsBool = false;
+    value.trueLabel = value.falseLabel = 0;
+    return value;
+}
+
+// Branches to the label it returns when a bool is the given way, and
+// falls through when it is the other; 0 if it never branches
+static int jumpWhen(CompileContext *ctx, ExprValue value, bool when) {
+    CodeGenerator *codeGen = ctx->codeGen;
+    if (value.known) {
+        if (value.boolValue != when) return 0;
+        int label = codeGen->newLabel();
+        codeGen->emitBranch(OP_GOTO, label);
+        return label;
+    }
+    value = asCondition(value);
+    int label = when ? value.trueLabel : value.falseLabel;
+    if (label == 0) {
+        label = codeGen->newLabel();
+    }
+    codeGen->emitBranch(when ? value.branch : (JvmOpcode)JvmInvertBranch(value.branch), label);
+    placeLabel(ctx, when ? value.falseLabel : value.trueLabel);
+    return label;
+}
+
+// Pushes a known value as type as, converted here rather than at run time
+static void pushKnown(CompileContext *ctx, ExprValue value, ExprType as) {
+    CodeGenerator *codeGen = ctx->codeGen;
+    switch (as) {
+        case TYPE_INT: codeGen->emitConstant(value.type == TYPE_REAL ? intOfReal(value.realValue) : value.intValue); break;
+        case TYPE_REAL: codeGen->emitConstant(realOf(value)); break;
+        case TYPE_BOOL: codeGen->emitConstant(value.boolValue ? 1 : 0); break;
+        case TYPE_STRING: codeGen->emitConstant(std::string(value.stringValue)); break;
+        default: break;
+    }
+}
+
+// Leaves a value on the stack as type as, converting between int and real
+// as an assignment does
+static void pushValue(CompileContext *ctx, ExprValue value, ExprType as) {
+    value = settleCondition(ctx, value);
+    if (value.known) {
+        pushKnown(ctx, value, as);
+    } else if (value.type == TYPE_INT && as == TYPE_REAL) {
+        ctx->codeGen->emitInstruction(OP_I2F);
+    } else if (value.type == TYPE_REAL && as == TYPE_INT) {
+        ctx->codeGen->emitInstruction(OP_F2I);
+    }
+}
+
+// Takes a value nothing uses off the stack
+static void dropValue(CompileContext *ctx, ExprValue value) {
+    value = settleCondition(ctx, value);
+    if (onStack(value)) {
+        ctx->codeGen->emitInstruction(OP_POP);
+    }
+}
+
+// a double is stored as one but computed with as a float
+static bool isDouble(const Name *type) {
+    return strcmp(type->text, "double") == 0;
+}
+
+// A float on the stack made a double.  One that is a double just loaded
+// or returned and narrowed is left the double it was.
+static void widenToDouble(CompileContext *ctx) {
+    if (!ctx->codeGen->undoNarrowing()) {
+        ctx->codeGen->emitInstruction(OP_F2D);
+    }
+}
+
+// The load of a local by the type of its values: iload for an int or a
+// bool, fload or dload, and aload for a string (a char is one too).  The
+// store is as far from istore.
+static JvmOpcode localLoad(const Name *type) {
+    switch (exprTypeOf(type)) {
+        case TYPE_REAL: return isDouble(type) ? OP_DLOAD : OP_FLOAD;
+        case TYPE_STRING: return OP_ALOAD;
+        default: return OP_ILOAD;
+    }
+}
+
+// Loads a global (a static field) or a local (a slot)
+static void loadVariable(CompileContext *ctx, const Symbol *symbol) {
+    if (symbol->slot < 0) {
+        ctx->codeGen->emitStaticField(OP_GETSTATIC, symbol->name);
+    } else {
+        ctx->codeGen->emitInstruction(localLoad(symbol->type), symbol->slot);
+    }
+    if (isDouble(symbol->type)) {
+        ctx->codeGen->emitInstruction(OP_D2F);
+    }
+}
+
+static void storeVariable(CompileContext *ctx, const Symbol *symbol) {
+    if (isDouble(symbol->type)) {
+        widenToDouble(ctx);
+    }
+    if (symbol->slot < 0) {
+        ctx->codeGen->emitStaticField(OP_PUTSTATIC, symbol->name);
+    } else {
+        JvmOpcode store = (JvmOpcode)(OP_ISTORE + (localLoad(symbol->type) - OP_ILOAD));
+        ctx->codeGen->emitInstruction(store, symbol->slot);
+    }
+}
+
+// zero, or null for a string
+static void pushDefault(CompileContext *ctx, ExprType type) {
+    switch (type) {
+        case TYPE_REAL: ctx->codeGen->emitInstruction(OP_FCONST_0); break;
+        case TYPE_STRING: ctx->codeGen->emitInstruction(OP_ACONST_NULL); break;
+        default: ctx->codeGen->emitInstruction(OP_ICONST_0); break;
+    }
+}
+
+// The local starts out as a field does, at zero (or null)
+static void storeDefault(CompileContext *ctx, const Symbol *symbol) {
+    pushDefault(ctx, exprTypeOf(symbol->type));
+    storeVariable(ctx, symbol);
+}
+
+// x++; or x--;  An int local is bumped in its slot with iinc.
+static void incrementVariable(CompileContext *ctx, const Symbol *symbol, int amount) {
+    ExprType type = exprTypeOf(symbol->type);
+    if (type == TYPE_INT && symbol->slot >= 0) {
+        ctx->codeGen->emitIncrement(symbol->slot, amount);
+        return;
+    }
+    loadVariable(ctx, symbol);
+    if (type == TYPE_INT) {
+        ctx->codeGen->emitInstruction(OP_ICONST_1);
+        ctx->codeGen->emitInstruction(amount > 0 ? OP_IADD : OP_ISUB);
+    } else {
+        ctx->codeGen->emitInstruction(OP_FCONST_1);
+        ctx->codeGen->emitInstruction(amount > 0 ? OP_FADD : OP_FSUB);
+    }
+    storeVariable(ctx, symbol);
+}
+
+// Stores a local declaration's initializers.  Those computed at run time
+// are on the stack in declaration order, so the list is walked backwards
+// (it is reversed, as nothing reads it after this).
+static void storeDeclarators(CompileContext *ctx, Node *head, const Name *type) {
+    Node *reversed = NULL;
+    while (head != NULL) {
+        Node *next = head->next;
+        head->next = reversed;
+        reversed = head;
+        head = next;
+    }
+    for (Node *node = reversed; node != NULL; node = node->next) {
+        Symbol *symbol = node->symbol;
+        if (!node->initialized) {
+            if (symbol != NULL) storeDefault(ctx, symbol);
+        } else if (symbol == NULL || symbol->value.known) {
+            dropValue(ctx, node->value); // not declared, or a const used in place
+        } else if (node->value.type != exprTypeOf(type)) {
+            dropValue(ctx, node->value);
+            storeDefault(ctx, symbol);
+        } else {
+            pushValue(ctx, node->value, node->value.type);
+            storeVariable(ctx, symbol);
+        }
+    }
+}
+
+// print or println of a value, with System.out already under it; a
+// double printed as it is loaded is printed as a double
+static void emitPrint(CompileContext *ctx, ExprValue value, const char *method) {
+    const char *param;
+    switch (value.type) {
+        case TYPE_INT: param = "int"; break;
+        case TYPE_REAL: param = "float"; break;
+        case TYPE_BOOL: param = "boolean"; break;
+        case TYPE_STRING: param = "java.lang.String"; break;
+        default:
+            yyerror(ctx, strcmp(method, "print") == 0 ? "Invalid type for print statement"
+                                                      : "Invalid type for println statement");
+            dropValue(ctx, value);
+            ctx->codeGen->emitInstruction(OP_POP); // System.out
+            return;
+    }
+    pushValue(ctx, value, value.type);
+    if (value.type == TYPE_REAL && ctx->codeGen->undoNarrowing()) {
+        param = "double";
+    }
+    ctx->codeGen->emitMethodInstruction(OP_INVOKEVIRTUAL, "void", "java.io.PrintStream", method, param);
+}
+
+// Returns the value on the stack from a function of the given type
+static void emitValueReturn(CompileContext *ctx, const Name *type) {
+    switch (exprTypeOf(type)) {
+        case TYPE_REAL:
+            if (isDouble(type)) {
+                widenToDouble(ctx);
+                ctx->codeGen->emitInstruction(OP_DRETURN);
+            } else {
+                ctx->codeGen->emitInstruction(OP_FRETURN);
+            }
+            break;
+        case TYPE_STRING: ctx->codeGen->emitInstruction(OP_ARETURN); break;
+        default: ctx->codeGen->emitInstruction(OP_IRETURN); break;
+    }
+}
+
+// Pushes an argument of the innermost call as the parameter it is for
+// takes it, and returns its type as declared
+static const Name *passArgument(CompileContext *ctx, ExprValue arg) {
+    CallSite *call = &ctx->call;
+    const Name *type = ctx->typeNames[arg.type];
+    if (call->function != NULL && call->argument < call->function->arity &&
+        exprTypeOf(call->function->paramTypes[call->argument]) == arg.type) {
+        type = call->function->paramTypes[call->argument];
+    }
+    call->argument++;
+    pushValue(ctx, arg, arg.type);
+    if (isDouble(type)) {
+        widenToDouble(ctx);
+    }
+    return type;
+}
+
+// Takes the arguments of a call that can't be made off the stack, last
+// first (the list is reversed, as nothing reads it after this)
+static void dropArguments(CompileContext *ctx, Parameter *head) {
+    Parameter *reversed = NULL;
+    while (head != NULL) {
+        Parameter *next = head->next;
+        head->next = reversed;
+        reversed = head;
+        head = next;
+    }
+    for (Parameter *arg = reversed; arg != NULL; arg = arg->next) {
+        ExprType type = exprTypeOf(arg->type);
+        if (type == TYPE_ERROR || type == TYPE_VOID) continue;
+        ctx->codeGen->emitInstruction(isDouble(arg->type) ? OP_POP2 : OP_POP);
+    }
+}
+
+// operators whose operands can be taken either way round
+static bool commutes(BinaryOp op, ExprType operandType) {
+    switch (op) {
+        case BIN_ADD: return operandType != TYPE_STRING; // not concatenation
+        case BIN_MUL: case BIN_EQ: case BIN_NEQ: case BIN_AND: case BIN_OR: return true;
+        default: return false;
+    }
+}
+
+// a < b is b > a
+static BinaryOp mirrored(BinaryOp op) {
+    switch (op) {
+        case BIN_LT: return BIN_GT;
+        case BIN_LEQ: return BIN_GEQ;
+        case BIN_GEQ: return BIN_LEQ;
+        case BIN_GT: return BIN_LT;
+        default: return op;
+    }
+}
+
+// Emits an operator of which at most one operand is known.  The known
+// operand is pushed only now, already converted; a computed int that
+// meets a real is converted with i2f.  With a known left operand, one
+// that commutes (or compares, mirrored) is worked out the other way
+// round, and the rest swap the operands back into order.  A comparison
+// is left as a condition: its branch is returned, not emitted.
+static JvmOpcode emitBinary(CompileContext *ctx, BinaryOp op, ExprValue left, ExprValue right) {
+    CodeGenerator *codeGen = ctx->codeGen;
+    bool comparison = op >= BIN_LT && op <= BIN_NEQ;
+    const BinaryRule *rule = &binaryRule(op, left.type, right.type);
+    ExprType operandType = rule->widen ? TYPE_REAL : left.type;
+    if (left.known && (comparison || commutes(op, operandType))) {
+        std::swap(left, right);
+        op = mirrored(op);
+        rule = &binaryRule(op, left.type, right.type);
+    }
+
+    if (right.known) {
+        // only the left operand is on the stack
+        if (rule->widen & WIDEN_LEFT) codeGen->emitInstruction(OP_I2F);
+        pushKnown(ctx, right, operandType);
+    } else if (left.known) {
+        // only the right operand is, and the order matters
+        if (rule->widen & WIDEN_RIGHT) codeGen->emitInstruction(OP_I2F);
+        pushKnown(ctx, left, operandType);
+        codeGen->emitInstruction(OP_SWAP);
+    } else {
+        if (rule->widen & WIDEN_RIGHT) codeGen->emitInstruction(OP_I2F);
+        if (rule->widen & WIDEN_LEFT) {
+            // the left operand is under the right one
+            codeGen->emitInstruction(OP_SWAP);
+            codeGen->emitInstruction(OP_I2F);
+            if (comparison) {
+                op = mirrored(op);
+                rule = &binaryRule(op, right.type, left.type);
+            } else if (!commutes(op, operandType)) {
+                codeGen->emitInstruction(OP_SWAP);
+            }
+        }
+    }
+
+    if (rule->opcode == OP_INVOKEVIRTUAL) {
+        if (comparison) {
+            codeGen->emitMethodInstruction(OP_INVOKEVIRTUAL, "int", "java.lang.String", "compareTo", "java.lang.String");
+        } else {
+            codeGen->emitMethodInstruction(OP_INVOKEVIRTUAL, "java.lang.String", "java.lang.String", "concat", "java.lang.String");
+        }
+    } else if (rule->opcode != OP_NOP) {
+        codeGen->emitInstruction(rule->opcode);
+    }
+    return rule->branch;
+}
+
+// Type-checks a binary operator through its rule table, and folds it when
+// both operands are known; otherwise emits it.  Ints wrap as they do on
+// the JVM.
+static ExprValue binaryExpression(CompileContext *ctx, BinaryOp op, ExprValue left, ExprValue right) {
+    ExprValue res = default_expr_error_value();
+    const BinaryRule &rule = binaryRule(op, left.type, right.type);
+    bool comparison = op >= BIN_LT && op <= BIN_NEQ;
+    if (rule.result == TYPE_ERROR) {
+        yyerror(ctx, (std::string("Type mismatch in ") + binaryOpName(op)).c_str());
+        dropValue(ctx, right);
+        dropValue(ctx, left);
+        if (comparison) {
+            // a comparison is a bool even so
+            res.type = TYPE_BOOL;
+            res.known = true;
+            res.boolValue = false;
+        }
+        return res;
+    }
+    if (rule.widen & WIDEN_LEFT) {
+        yywarning(ctx, (std::string("Implicit conversion from int to real in ") + binaryOpName(op) + " (left operand).").c_str());
+    } else if (rule.widen & WIDEN_RIGHT) {
+        yywarning(ctx, (std::string("Implicit conversion from int to real in ") + binaryOpName(op) + " (right operand).").c_str());
+    }
+    if ((op == BIN_DIV || op == BIN_MOD) && right.known &&
+        (right.type == TYPE_INT ? right.intValue == 0 : right.realValue == 0.0f)) {
+        yyerror(ctx, op == BIN_MOD ? "Modulus by zero"
+                     : rule.result == TYPE_INT ? "Division by zero (integer)"
+                     : "Division by zero (float)");
+        dropValue(ctx, left);
+        return res;
+    }
+    res.type = rule.result;
+    if (!left.known || !right.known) {
+        res.branch = emitBinary(ctx, op, left, right);
+        return res;
+    }
+
+    res.known = true;
+    if (comparison) {
+        int order;
+        if (left.type == TYPE_STRING) {
+            order = strcmp(left.stringValue, right.stringValue);
+        } else if (left.type == TYPE_INT && right.type == TYPE_INT) {
+            order = (left.intValue > right.intValue) - (left.intValue < right.intValue);
+        } else {
+            float l = realOf(left), r = realOf(right);
+            if (l != l || r != r) {
+                res.boolValue = op == BIN_NEQ; // NaN
+                return res;
+            }
+            order = (l > r) - (l < r);
+        }
+        switch (op) {
+            case BIN_LT: res.boolValue = order < 0; break;
+            case BIN_LEQ: res.boolValue = order <= 0; break;
+            case BIN_EQ: res.boolValue = order == 0; break;
+            case BIN_GEQ: res.boolValue = order >= 0; break;
+            case BIN_GT: res.boolValue = order > 0; break;
+            default: res.boolValue = order != 0; break;
+        }
+    } else if (rule.result == TYPE_INT) {
+        unsigned int l = (unsigned int)left.intValue, r = (unsigned int)right.intValue;
+        switch (op) {
+            case BIN_ADD: res.intValue = (int)(l + r); break;
+            case BIN_SUB: res.intValue = (int)(l - r); break;
+            case BIN_MUL: res.intValue = (int)(l * r); break;
+            case BIN_DIV: res.intValue = (right.intValue == -1) ? (int)(0u - l) : left.intValue / right.intValue; break;
+            default: res.intValue = (right.intValue == -1) ? 0 : left.intValue % right.intValue; break;
+        }
+    } else if (rule.result == TYPE_REAL) {
+        float l = realOf(left), r = realOf(right);
+        switch (op) {
+            case BIN_ADD: res.realValue = l + r; break;
+            case BIN_SUB: res.realValue = l - r; break;
+            case BIN_MUL: res.realValue = l * r; break;
+            default: res.realValue = l / r; break;
+        }
+    } else if (rule.result == TYPE_BOOL) {
+        res.boolValue = (op == BIN_AND) ? (left.boolValue && right.boolValue)
+                                        : (left.boolValue || right.boolValue);
+    } else {
+        // string concatenation
+        size_t leftLength = strlen(left.stringValue);
+        char *text = (char *)arenaAlloc(ctx->arena, leftLength + strlen(right.stringValue) + 1);
+        strcpy(text, left.stringValue);
+        strcpy(text + leftLength, right.stringValue);
+        res.stringValue = text;
+    }
     return res;
 }
 
-void yyerror(const char *s) {
-    fprintf(stderr, "Error at line %d: %s\n", linenum, s);
+static ExprValue unaryExpression(CompileContext *ctx, UnaryOp op, ExprValue operand) {
+    static const char *messages[UNARY_OP_COUNT] = {
+        "Invalid type for unary minus", "Invalid type for logical NOT",
+        "Invalid type for increment", "Invalid type for decrement"
+    };
+    ExprValue res = default_expr_error_value();
+    const UnaryRule &rule = unaryRule(op, operand.type);
+    if (rule.result == TYPE_ERROR) {
+        yyerror(ctx, messages[op]);
+        dropValue(ctx, operand);
+        return res;
+    }
+    if (op == UN_NOT && !operand.known) {
+        // the same tests with their outcomes swapped
+        res = asCondition(operand);
+        res.branch = (JvmOpcode)JvmInvertBranch(res.branch);
+        std::swap(res.trueLabel, res.falseLabel);
+        return res;
+    }
+    res.type = rule.result;
+    res.known = operand.known;
+    if (!res.known) {
+        if (op == UN_INC || op == UN_DEC) {
+            ctx->codeGen->emitInstruction(res.type == TYPE_INT ? OP_ICONST_1 : OP_FCONST_1);
+        }
+        ctx->codeGen->emitInstruction(rule.opcode); // ineg, fneg, iadd, ...
+        return res;
+    }
+    if (op == UN_NOT) {
+        res.boolValue = !operand.boolValue;
+    } else if (res.type == TYPE_INT) {
+        unsigned int v = (unsigned int)operand.intValue;
+        res.intValue = (int)(op == UN_NEG ? 0u - v : op == UN_INC ? v + 1 : v - 1);
+    } else {
+        float v = operand.realValue;
+        res.realValue = op == UN_NEG ? -v : op == UN_INC ? v + 1.0f : v - 1.0f;
+    }
+    return res;
 }
 
-void yywarning(const char *s) {
-    fprintf(stderr, "Warning at line %d: %s\n", linenum, s);
+// The then part of an if with an else is done: it jumps over the else
+// part (unless it can't get to its end), which the condition's false
+// label starts
+static int skipElse(CompileContext *ctx, int falseLabel) {
+    int end = 0;
+    if (ctx->codeGen->reachable()) {
+        end = ctx->codeGen->newLabel();
+        ctx->codeGen->emitBranch(OP_GOTO, end);
+    }
+    placeLabel(ctx, falseLabel);
+    return end;
 }
 
+// A loop's body is done: back to the test, and out of the loop
+static void endLoop(CompileContext *ctx, LoopLabels labels) {
+    if (ctx->codeGen->reachable()) {
+        ctx->codeGen->emitBranch(OP_GOTO, labels.repeat);
+    }
+    placeLabel(ctx, labels.exit);
+}
+
+// a && b and a || b, short-circuit: the left operand has already jumped
+// to label where it decides the result (see the grammar), and the right
+// one is added to those jumps as a condition
+static ExprValue logicalExpression(CompileContext *ctx, BinaryOp op, ExprValue left, int label, ExprValue right) {
+    if (binaryRule(op, left.type, right.type).result == TYPE_ERROR) {
+        yyerror(ctx, (std::string("Type mismatch in ") + binaryOpName(op)).c_str());
+        dropValue(ctx, right);
+        if (label != 0) {
+            placeLabel(ctx, label);
+        } else {
+            dropValue(ctx, left);
+        }
+        return default_expr_error_value();
+    }
+    if (label == 0) {
+        return right; // true && b, false || b
+    }
+    if (right.known) {
+        pushKnown(ctx, right, TYPE_BOOL);
+        right.known = false;
+    }
+    ExprValue res = asCondition(right);
+    if (op == BIN_AND) {
+        res.falseLabel = ctx->codeGen->joinLabels(label, res.falseLabel);
+    } else {
+        res.trueLabel = ctx->codeGen->joinLabels(label, res.trueLabel);
+    }
+    return res;
+}
 
 %}
 
+%code requires {
+#include "compile_context.h"
+}
+
+%code provides {
+int yylex(YYSTYPE *yylval, void *scanner);
+}
+
+%define api.pure full
+%lex-param {void *scanner}
+%parse-param {void *scanner} {CompileContext *ctx}
+
 %union {
-    char *string;   // For type_specifier (int, float...)
-    Node *node;     // For declarator_list and declarator_list_with_init
+    Node *node;     // For a declarator
+    NodeList nodes; // For declarator_list
     int intval;     // For integer constants
     float realval;  // For real constants
     bool boolval;    // For boolean constants
-    char *text;     // For string constants (ID, string...)
-    Parameter *param ; // For function parameters
+    Span span;      // For string constants, where they are in the source
+    Parameter *param ; // For a function parameter or an argument
+    ParameterList params; // For parameter and argument lists
+    const Name *name;  // For identifiers and type names, interned
     ExprValue expr_val;
+    CallSite call;   // For the call a nested one is an argument of
+    LoopLabels loop; // For a loop's head
 }
 
 // define token
-%token <string> KW_BOOL KW_BREAK KW_CASE KW_CHAR KW_CONST KW_CONTINUE KW_DEFAULT KW_DO KW_DOUBLE KW_ELSE KW_EXTERN KW_FLOAT KW_FOR KW_FOREACH KW_IF KW_INT KW_MAIN KW_PRINT KW_PRINTLN KW_READ KW_RETURN KW_STRING KW_SWITCH KW_VOID KW_WHILE
-%token <text> ID
+%token KW_BOOL KW_BREAK KW_CASE KW_CHAR KW_CONST KW_CONTINUE KW_DEFAULT KW_DO KW_DOUBLE KW_ELSE KW_EXTERN KW_FLOAT KW_FOR KW_FOREACH KW_IF KW_INT KW_MAIN KW_PRINT KW_PRINTLN KW_READ KW_RETURN KW_STRING KW_SWITCH KW_VOID KW_WHILE
+%token <name> ID
 %token <intval> INT
 %token <realval> REAL
 %token <boolval> BOOL
-%token <text> STRING
-%token <string> OP_INC OP_ADD OP_DEC OP_SUB OP_MUL OP_DIV OP_MOD OP_EQ OP_NEQ OP_LEQ OP_GEQ OP_ASSIGN OP_LT OP_GT OP_OR OP_AND OP_NOT
-%token <string> DELIM_LPAR DELIM_RPAR DELIM_LBRACK DELIM_RBRACK DELIM_LBRACE DELIM_RBRACE DELIM_COMMA DELIM_DOT DELIM_COLON DELIM_SEMICOLON
+%token <span> STRING
+%token OP_INC OP_ADD OP_DEC OP_SUB OP_MUL OP_DIV OP_MOD OP_EQ OP_NEQ OP_LEQ OP_GEQ OP_ASSIGN OP_LT OP_GT OP_OR OP_AND OP_NOT
+%token DELIM_LPAR DELIM_RPAR DELIM_LBRACK DELIM_RBRACK DELIM_LBRACE DELIM_RBRACE DELIM_COMMA DELIM_DOT DELIM_COLON DELIM_SEMICOLON
 
-%type <string> type_specifier
-%type <node> declarator_list
+%type <name> type_specifier
+%type <node> declarator
+%type <nodes> declarator_list
 %type <expr_val> expression
 %type <expr_val> arithmetic_expression
-%type <param> parameter_list
-%type <param> argument_list
-%type <param> argument_list_actual
+%type <expr_val> control_expression
+%type <expr_val> condition
+%type <intval> if_head if_else_head
+%type <loop> while_head for_head
+%type <param> parameter
+%type <params> parameter_list
+%type <params> parameters
+%type <params> argument_list
+%type <params> argument_list_actual
 %type <expr_val> function_invocation
 
 %left OP_OR
@@ -86,18 +697,31 @@ void yywarning(const char *s) {
 
 %%
 
+// Lists are left recursive, so each item is reduced as soon as it is
+// read and the parser stack only grows with nesting, not with length
 program:
-    declaration program
-    | function_declaration program
-    | main_function 
+    top_level_items main_function
+    ;
+
+top_level_items:
+    top_level_items declaration
+    | top_level_items function_declaration
+    | /* empty */
     ;
 
 main_function:
     KW_VOID KW_MAIN DELIM_LPAR DELIM_RPAR {
-        codeGen->emitMethod("main", "void", "java.lang.String[]");
-        codeGen->emitMethodStart();
+        ctx->codeGen->emitMethod("main", "void", "java.lang.String[]");
+        ctx->codeGen->emitMethodStart();
+        ctx->functionMark = arenaMark(ctx->arena);
+        ctx->symbolTable->nextSlot = 1; // slot 0 holds the String[] argument
     } block {
-        codeGen->emitMethodEnd();
+        if (ctx->codeGen->reachable()) {
+            ctx->codeGen->emitReturn();
+        }
+        ctx->codeGen->emitMethodEnd();
+        ctx->symbolTable->nextSlot = 0;
+        arenaRelease(ctx->arena, ctx->functionMark); // reduced with no lookahead token pending
     }
     ;
 
@@ -105,675 +729,271 @@ declaration:
     // single or multiple declaration
     type_specifier declarator_list DELIM_SEMICOLON {
         // traverse declarator_list，insert each one into symbol table
-        Node *current = $2;
+        Node *current = $2.head;
         while (current != NULL) {
-            if (lookupSymbolInCurrentTable(currentTable, current->name)) {
-                yyerror("Duplicate declaration of variable");
-            } else if (current->type != NULL) {
+            if (lookupSymbolInCurrentScope(ctx->symbolTable, current->name)) {
+                yyerror(ctx, "Duplicate declaration of variable");
+            } else if (current->initialized) {
                 // type check
-                if (current->type == "INT" && $1 != "int") 
-                    yyerror("Type mismatch in declaration");
-                else if (current->type == "REAL" && $1 != "float" && $1 != "double")
-                    yyerror("Type mismatch in declaration");
-                else if (current->type == "BOOL" && $1 != "bool")
-                    yyerror("Type mismatch in declaration");
-                else if (current->type == "STRING" && $1 != "string" && $1 != "char")
-                    yyerror("Type mismatch in declaration");
+                if (current->value.type != TYPE_ERROR && current->value.type != exprTypeOf($1))
+                    yyerror(ctx, "Type mismatch in declaration");
             }
-            insertSymbol(currentTable, current->name, $1, 0);
+            current->symbol = insertSymbol(ctx->symbolTable, current->name, $1, 0);
                 // code generation
-                if (currentTable->parent == NULL) {
+                if (ctx->symbolTable->depth == 0) {
                     // Global variable
-                    std::string tmpValueStr = "";
-                    if (current->value != NULL) {
-                        if (current->type == "INT") {
-                            tmpValueStr = std::to_string(*(int *)current->value);
-                        } else if (current->type == "REAL") {
-                            tmpValueStr = std::to_string(*(float *)current->value);
-                        } else if (current->type == "BOOL") {
-                            tmpValueStr = (*(bool *)current->value) ? "true" : "false";
-                        } else if (current->type == "STRING") {
-                            tmpValueStr = "\"" + std::string((char *)current->value) + "\"";
-                        }
-                    }
-                    codeGen->emitField(current->name, $1, tmpValueStr);
+                    std::string tmpValueStr = current->initialized ? fieldInitializer(current->value) : "";
+                    ctx->codeGen->emitField(current->name, $1->text, tmpValueStr);
                     // TODO: assign must be out eg. field static integer b = 10
-                } else {
-                    // TODO: Local variable
+                    if (current->initialized) dropValue(ctx, current->value);
                 }
             current = current->next;
         }
+        if (ctx->symbolTable->depth > 0) {
+            // Local variables, in their slots
+            storeDeclarators(ctx, $2.head, $1);
+        }
     }
     // single or multi const declare
     | KW_CONST type_specifier declarator_list DELIM_SEMICOLON {
         // printf("Const declaration: type=%s\n", $2);   // for debugging
 
-        Node *current = $3;
+        Node *current = $3.head;
         while (current != NULL) {
-            if (lookupSymbolInCurrentTable(currentTable, current->name)) {
-                yyerror("Duplicate declaration of variable");
-            } else if (current->value == NULL) {
-                yyerror("Const variable must be initialized");
-            } else if (current->type != NULL) {
+            if (lookupSymbolInCurrentScope(ctx->symbolTable, current->name)) {
+                yyerror(ctx, "Duplicate declaration of variable");
+            } else if (!current->initialized) {
+                yyerror(ctx, "Const variable must be initialized");
+            } else {
                 // type check
-                if (current->type == "INT" && $2 != "int") 
-                    yyerror("Type mismatch in declaration");
-                else if (current->type == "REAL" && $2 != "float" && $2 != "double")
-                    yyerror("Type mismatch in declaration");
-                else if (current->type == "BOOL" && $2 != "bool")
-                    yyerror("Type mismatch in declaration");
-                else if (current->type == "STRING" && $2 != "string" && $2 != "char")
-                    yyerror("Type mismatch in declaration");
-
-                insertSymbol(currentTable, current->name, $2, 1); // set as const
-                
+                if (current->value.type != TYPE_ERROR && current->value.type != exprTypeOf($2))
+                    yyerror(ctx, "Type mismatch in declaration");
+
+                current->symbol = insertSymbol(ctx->symbolTable, current->name, $2, 1); // set as const
+                if (current->value.known && current->value.type == exprTypeOf($2)) {
+                    current->symbol->value = current->value; // used in place of the variable
+                }
             } 
             // code generation
-            if (currentTable->parent == NULL) {
+            if (ctx->symbolTable->depth == 0) {
                 // Global variable
-                std::string tmpValueStr = "";
-                if (current->value != NULL) {
-                    if (current->type == "INT") {
-                        tmpValueStr = std::to_string(*(int *)current->value);
-                    } else if (current->type == "REAL") {
-                        tmpValueStr = std::to_string(*(float *)current->value);
-                    } else if (current->type == "BOOL") {
-                        tmpValueStr = (*(bool *)current->value) ? "true" : "false";
-                    } else if (current->type == "STRING") {
-                        tmpValueStr = "\"" + std::string((char *)current->value) + "\"";
-                    }
-                }
-                codeGen->emitField(current->name, $2, tmpValueStr);
+                std::string tmpValueStr = current->initialized ? fieldInitializer(current->value) : "";
+                ctx->codeGen->emitField(current->name, $2->text, tmpValueStr);
                 // TODO: assign must be out eg. field static integer b = 10
-            } else {
-                // TODO: Local variable
+                if (current->initialized) dropValue(ctx, current->value);
             }
             current = current->next;
         }
+        if (ctx->symbolTable->depth > 0) {
+            // a const whose value isn't known has a slot as well
+            storeDeclarators(ctx, $3.head, $2);
+        }
     }
     ;
     
 type_specifier:
-    KW_INT { $$ = "int";}
-    | KW_FLOAT { $$ = "float";}
-    | KW_DOUBLE { $$ = "double";}
-    | KW_CHAR { $$ = "char";}
-    | KW_BOOL { $$ = "bool";}
-    | KW_STRING { $$ = "string";}
+    KW_INT { $$ = intern(ctx->names, "int"); }
+    | KW_FLOAT { $$ = intern(ctx->names, "float"); }
+    | KW_DOUBLE { $$ = intern(ctx->names, "double"); }
+    | KW_CHAR { $$ = intern(ctx->names, "char"); }
+    | KW_BOOL { $$ = intern(ctx->names, "bool"); }
+    | KW_STRING { $$ = intern(ctx->names, "string"); }
     ;
 
-declarator_list:
+declarator:
     ID {
-        // single declaration without initialization
-        $$ = (Node *)malloc(sizeof(Node));
-        $$->name = strdup($1);
-        $$->type = NULL; // no type yet
+        // declaration without initialization
+        $$ = (Node *)arenaAlloc(ctx->arena, sizeof(Node));
+        $$->name = $1;
+        $$->initialized = false; // no initialization
+        $$->symbol = NULL;
         $$->next = NULL;
-        $$->value = NULL; // no initialization
     }
     | ID OP_ASSIGN expression {
-        // single declaration with initialization
-        $$ = (Node *)malloc(sizeof(Node));
-        $$->name = strdup($1);
-        $$->type = $3.type;
+        // declaration with initialization
+        $$ = (Node *)arenaAlloc(ctx->arena, sizeof(Node));
+        $$->name = $1;
+        $$->initialized = true;
+        $$->value = settleCondition(ctx, $3); // initialization value, on the stack if not known
+        $$->symbol = NULL;
         $$->next = NULL;
-        $$->value = $3.value; // initialization value
-    }
-    | ID DELIM_COMMA declarator_list {
-        // multi declaration without initialization
-        $$ = (Node *)malloc(sizeof(Node));
-        $$->name = strdup($1);
-        $$->type = $3->type;
-        $$->next = $3;
-        $$->value = NULL;
-    }
-    | ID OP_ASSIGN expression DELIM_COMMA declarator_list {
-        // multi declaration with initialization
-        $$ = (Node *)malloc(sizeof(Node));
-        $$->name = strdup($1);
-        $$->type = $3.type;
-        $$->next = $5;
-        $$->value = $3.value;
+    }
+    ;
+
+declarator_list:
+    declarator {
+        // single declaration
+        $$.head = $$.tail = $1;
+    }
+    | declarator_list DELIM_COMMA declarator {
+        // multi declaration, kept in source order
+        $$ = $1;
+        $$.tail->next = $3;
+        $$.tail = $3;
     }
     ;
 
 arithmetic_expression:
     OP_SUB expression %prec OP_INC {
         // Unary minus
-        if (strcmp($2.type, "INT") == 0) {
-            $$.type = "INT";
-            $$.value = malloc(sizeof(int));
-            *(int *)$$.value = -(*(int *)$2.value);
-        } else if (strcmp($2.type, "REAL") == 0) {
-            $$.type = "REAL";
-            $$.value = malloc(sizeof(float));
-            *(float *)$$.value = -(*(float *)$2.value);
-        } else {
-            yyerror("Invalid type for unary minus");
-            $$ = default_expr_error_value(); // Set to error value
-        }
-        if ($2.value) free($2.value); // Free operand value
+        $$ = unaryExpression(ctx, UN_NEG, $2);
     }
     | expression OP_INC {
         // Increment
-        if (strcmp($1.type, "INT") == 0) {
-            $$.type = "INT";
-            $$.value = malloc(sizeof(int));
-            *(int *)$$.value = (*(int *)$1.value) + 1;
-        } else if (strcmp($1.type, "REAL") == 0) {
-            $$.type = "REAL";
-            $$.value = malloc(sizeof(float));
-            *(float *)$$.value = (*(float *)$1.value) + 1.0;
-        } else {
-            yyerror("Invalid type for increment");
-            $$ = default_expr_error_value(); // Set to error value
-        }
-        if ($1.value) free($1.value); // Free operand value
+        $$ = unaryExpression(ctx, UN_INC, $1);
     }
     | expression OP_DEC {
         // Decrement
-        if (strcmp($1.type, "INT") == 0) {
-            $$.type = "INT";
-            $$.value = malloc(sizeof(int));
-            *(int *)$$.value = (*(int *)$1.value) - 1;
-        } else if (strcmp($1.type, "REAL") == 0) {
-            $$.type = "REAL";
-            $$.value = malloc(sizeof(float));
-            *(float *)$$.value = (*(float *)$1.value) - 1.0;
-        } else {
-            yyerror("Invalid type for decrement");
-            $$ = default_expr_error_value(); // Set to error value
-        }
-        if ($1.value) free($1.value); // Free operand value
+        $$ = unaryExpression(ctx, UN_DEC, $1);
     }
     | expression OP_MUL expression {
-        // Multiplication
-        $$ = default_expr_error_value();
-        bool mixed_types_numeric = false;
-        if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "INT") == 0) {
-            $$.type = "INT";
-            $$.value = malloc(sizeof(int));
-            *(int *)$$.value = (*(int *)$1.value) * (*(int *)$3.value);
-        } else if ((strcmp($1.type, "REAL") == 0 || strcmp($1.type, "INT") == 0) &&
-                   (strcmp($3.type, "REAL") == 0 || strcmp($3.type, "INT") == 0)) {
-            $$.type = "REAL";
-            $$.value = malloc(sizeof(float));
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            *(float *)$$.value = val1 * val2;
-
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-                mixed_types_numeric = true;
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-                mixed_types_numeric = true;
-            }
-
-        } else {
-            yyerror("Type mismatch in multiplication");
-        }
-        if ($1.value) free($1.value); // Free operand values
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_MUL, $1, $3);
     }
     | expression OP_DIV expression {
-        // Division
-        $$ = default_expr_error_value();
-        bool mixed_types_numeric = false;
-        if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "INT") == 0) {
-            if (*(int *)$3.value == 0) {
-                yyerror("Division by zero (integer)");
-            } else {
-                $$.type = "INT";
-                $$.value = malloc(sizeof(int));
-                *(int *)$$.value = (*(int *)$1.value) / (*(int *)$3.value);
-            }
-        } else if ((strcmp($1.type, "REAL") == 0 || strcmp($1.type, "INT") == 0) &&
-                   (strcmp($3.type, "REAL") == 0 || strcmp($3.type, "INT") == 0)) {
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            if (val2 == 0.0) {
-                yyerror("Division by zero (float)");
-            } else {
-                $$.type = "REAL";
-                $$.value = malloc(sizeof(float));
-                *(float *)$$.value = val1 / val2;
-            }
-
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-                mixed_types_numeric = true;
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-                mixed_types_numeric = true;
-            }
-
-        } else {
-            yyerror("Type mismatch in division");
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_DIV, $1, $3);
     }
     | expression OP_MOD expression {
-        // Modulus
-        if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "INT") == 0) {
-            if (*(int *)$3.value == 0) {
-                yyerror("Modulus by zero");
-            } else {
-                $$.type = "INT";
-                $$.value = malloc(sizeof(int));
-                *(int *)$$.value = (*(int *)$1.value) % (*(int *)$3.value);
-            }
-        } else {
-            yyerror("Type mismatch in modulus");
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_MOD, $1, $3);
     }
     | expression OP_ADD expression {
-        // Addition
-        $$ = default_expr_error_value();
-        bool mixed_types_numeric = false;
-        if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "INT") == 0) {
-            $$.type = "INT";
-            $$.value = malloc(sizeof(int));
-            *(int *)$$.value = (*(int *)$1.value) + (*(int *)$3.value);
-        } else if ((strcmp($1.type, "REAL") == 0 || strcmp($1.type, "INT") == 0) &&
-                   (strcmp($3.type, "REAL") == 0 || strcmp($3.type, "INT") == 0)) {
-            $$.type = "REAL";
-            $$.value = malloc(sizeof(float));
-            float left = (strcmp($1.type, "INT") == 0) ? (float)(*(int *)$1.value) : (*(float *)$1.value);
-            float right = (strcmp($3.type, "INT") == 0) ? (float)(*(int *)$3.value) : (*(float *)$3.value);
-            *(float *)$$.value = left + right;
-
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-                mixed_types_numeric = true;
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-                mixed_types_numeric = true;
-            }
-
-        } else if (strcmp($1.type, "STRING") == 0 && strcmp($3.type, "STRING") == 0) {
-            // String concatenation
-            $$.type = "STRING";
-            char *s1 = (char*)$1.value;
-            char *s2 = (char*)$3.value;
-            $$.value = malloc(strlen(s1) + strlen(s2) + 1);
-            strcpy((char*)$$.value, s1);
-            strcat((char*)$$.value, s2);
-        }
-         else {
-            yyerror("Type mismatch in addition");
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        // Addition, or concatenation of strings
+        $$ = binaryExpression(ctx, BIN_ADD, $1, $3);
     }
     | expression OP_SUB expression {
-        // Subtraction
-        $$ = default_expr_error_value();
-        bool mixed_types_numeric = false;
-        if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "INT") == 0) {
-            $$.type = "INT";
-            $$.value = malloc(sizeof(int));
-            *(int *)$$.value = (*(int *)$1.value) - (*(int *)$3.value);
-        } else if ((strcmp($1.type, "REAL") == 0 || strcmp($1.type, "INT") == 0) &&
-                   (strcmp($3.type, "REAL") == 0 || strcmp($3.type, "INT") == 0)) {
-            $$.type = "REAL";
-            $$.value = malloc(sizeof(float));
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            *(float *)$$.value = val1 - val2;
-
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-                mixed_types_numeric = true;
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-                mixed_types_numeric = true;
-            }
-            
-        } else {
-            yyerror("Type mismatch in subtraction");
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_SUB, $1, $3);
     }
     | expression OP_LT expression {
-        // Less than
-        $$ = default_expr_error_value();
-        $$.type = "BOOL"; // Result is always BOOL
-        $$.value = malloc(sizeof(bool));
-        if ((strcmp($1.type, "INT") == 0 || strcmp($1.type, "REAL") == 0) &&
-            (strcmp($3.type, "INT") == 0 || strcmp($3.type, "REAL") == 0)) {
-            // Warning
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-            }
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            *(bool *)$$.value = val1 < val2;
-        } else if (strcmp($1.type, "STRING") == 0 && strcmp($3.type, "STRING") == 0) {
-             *(bool *)$$.value = strcmp((char*)$1.value, (char*)$3.value) < 0;
-        }
-        else {
-            yyerror("Type mismatch in less than comparison");
-            *(bool *)$$.value = false; // Default on error
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_LT, $1, $3);
     }
     | expression OP_LEQ expression {
-        // Less than or equal to
-        $$ = default_expr_error_value();
-        $$.type = "BOOL"; // Result is always BOOL
-        $$.value = malloc(sizeof(bool));
-        if ((strcmp($1.type, "INT") == 0 || strcmp($1.type, "REAL") == 0) &&
-            (strcmp($3.type, "INT") == 0 || strcmp($3.type, "REAL") == 0)) {
-            // Warning
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-            }
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            *(bool *)$$.value = val1 <= val2;
-        } else if (strcmp($1.type, "STRING") == 0 && strcmp($3.type, "STRING") == 0) {
-             *(bool *)$$.value = strcmp((char*)$1.value, (char*)$3.value) <= 0;
-        }
-        else {
-            yyerror("Type mismatch in less equal comparison");
-            *(bool *)$$.value = false; // Default on error
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_LEQ, $1, $3);
     }
     | expression OP_EQ expression {
-        // Equal to
-        $$ = default_expr_error_value();
-        $$.type = "BOOL"; // Result is always BOOL
-        $$.value = malloc(sizeof(bool));
-        if ((strcmp($1.type, "INT") == 0 || strcmp($1.type, "REAL") == 0) &&
-            (strcmp($3.type, "INT") == 0 || strcmp($3.type, "REAL") == 0)) {
-            // Warning
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-            }
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            *(bool *)$$.value = val1 == val2;
-        } else if (strcmp($1.type, "STRING") == 0 && strcmp($3.type, "STRING") == 0) {
-             *(bool *)$$.value = strcmp((char*)$1.value, (char*)$3.value) == 0;
-        }
-        else {
-            yyerror("Type mismatch in equal comparison");
-            *(bool *)$$.value = false; // Default on error
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_EQ, $1, $3);
     }
     | expression OP_GEQ expression {
-        // Greater than or equal to
-        $$ = default_expr_error_value();
-        $$.type = "BOOL"; // Result is always BOOL
-        $$.value = malloc(sizeof(bool));
-        if ((strcmp($1.type, "INT") == 0 || strcmp($1.type, "REAL") == 0) &&
-            (strcmp($3.type, "INT") == 0 || strcmp($3.type, "REAL") == 0)) {
-            // Warning
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-            }
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            *(bool *)$$.value = val1 >= val2;
-        } else if (strcmp($1.type, "STRING") == 0 && strcmp($3.type, "STRING") == 0) {
-             *(bool *)$$.value = strcmp((char*)$1.value, (char*)$3.value) >= 0;
-        }
-        else {
-            yyerror("Type mismatch in greater equal comparison");
-            *(bool *)$$.value = false; // Default on error
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_GEQ, $1, $3);
     }
     | expression OP_GT expression {
-        // Greater than
-        $$ = default_expr_error_value();
-        $$.type = "BOOL"; // Result is always BOOL
-        $$.value = malloc(sizeof(bool));
-        if ((strcmp($1.type, "INT") == 0 || strcmp($1.type, "REAL") == 0) &&
-            (strcmp($3.type, "INT") == 0 || strcmp($3.type, "REAL") == 0)) {
-            // Warning
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-            }
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            *(bool *)$$.value = val1 > val2;
-        } else if (strcmp($1.type, "STRING") == 0 && strcmp($3.type, "STRING") == 0) {
-             *(bool *)$$.value = strcmp((char*)$1.value, (char*)$3.value) > 0;
-        }
-        else {
-            yyerror("Type mismatch in greater than comparison");
-            *(bool *)$$.value = false; // Default on error
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_GT, $1, $3);
     }
     | expression OP_NEQ expression {
-        // Not equal to
-        $$ = default_expr_error_value();
-        $$.type = "BOOL"; // Result is always BOOL
-        $$.value = malloc(sizeof(bool));
-        if ((strcmp($1.type, "INT") == 0 || strcmp($1.type, "REAL") == 0) &&
-            (strcmp($3.type, "INT") == 0 || strcmp($3.type, "REAL") == 0)) {
-            // Warning
-            if (strcmp($1.type, "INT") == 0 && strcmp($3.type, "REAL") == 0) {
-                yywarning("Implicit conversion from int to real in addition (left operand).");
-            } else if (strcmp($1.type, "REAL") == 0 && strcmp($3.type, "INT") == 0) {
-                yywarning("Implicit conversion from int to real in addition (right operand).");
-            }
-            float val1 = (strcmp($1.type, "INT") == 0) ? (float)(*(int*)$1.value) : (*(float*)$1.value);
-            float val2 = (strcmp($3.type, "INT") == 0) ? (float)(*(int*)$3.value) : (*(float*)$3.value);
-            *(bool *)$$.value = val1 != val2;
-        } else if (strcmp($1.type, "STRING") == 0 && strcmp($3.type, "STRING") == 0) {
-             *(bool *)$$.value = strcmp((char*)$1.value, (char*)$3.value) != 0;
-        }
-        else {
-            yyerror("Type mismatch in not equal comparison");
-            *(bool *)$$.value = false; // Default on error
-        }
-        if ($1.value) free($1.value);
-        if ($3.value) free($3.value);
+        $$ = binaryExpression(ctx, BIN_NEQ, $1, $3);
     }
     | OP_NOT expression {
         // Logical NOT
-        $$ = default_expr_error_value();
-        if (strcmp($2.type, "BOOL") == 0) {
-            $$.type = "BOOL";
-            $$.value = malloc(sizeof(bool));
-            *(bool *)$$.value = !(*(bool *)$2.value);
-        } else {
-            yyerror("Invalid type for logical NOT");
-        }
-        if ($2.value) free($2.value); // Free operand value
+        $$ = unaryExpression(ctx, UN_NOT, $2);
     }
-    | expression OP_AND expression {
-        // Logical AND
-        $$ = default_expr_error_value();
-        if (strcmp($1.type, "BOOL") == 0 && strcmp($3.type, "BOOL") == 0) {
-            $$.type = "BOOL";
-            $$.value = malloc(sizeof(bool));
-            *(bool *)$$.value = (*(bool *)$1.value) && (*(bool *)$3.value);
-        } else {
-            yyerror("Type mismatch in logical AND");
-        }
-        if ($1.value) free($1.value); // Free operand values
-        if ($3.value) free($3.value);
+    | expression OP_AND {
+        // a false left operand skips the right one
+        $<intval>$ = ($1.type == TYPE_BOOL) ? jumpWhen(ctx, $1, false) : 0;
+    } expression {
+        $$ = logicalExpression(ctx, BIN_AND, $1, $<intval>3, $4);
     }
-    | expression OP_OR expression {
-        // Logical OR
-        $$ = default_expr_error_value();
-        if (strcmp($1.type, "BOOL") == 0 && strcmp($3.type, "BOOL") == 0) {
-            $$.type = "BOOL";
-            $$.value = malloc(sizeof(bool));
-            *(bool *)$$.value = (*(bool *)$1.value) || (*(bool *)$3.value);
-        } else {
-            yyerror("Type mismatch in logical OR");
-        }
-        if ($1.value) free($1.value); // Free operand values
-        if ($3.value) free($3.value);
+    | expression OP_OR {
+        // and a true one does here
+        $<intval>$ = ($1.type == TYPE_BOOL) ? jumpWhen(ctx, $1, true) : 0;
+    } expression {
+        $$ = logicalExpression(ctx, BIN_OR, $1, $<intval>3, $4);
     }
     | DELIM_LPAR expression DELIM_RPAR {
         // Parentheses
-        $$.type = $2.type;
-        $$.value = $2.value;
+        $$ = $2;
     }
     ;
 
 expression:
     INT {
-        $$.type = "INT";
-        $$.value = malloc(sizeof(int));
-        *(int *)$$.value = $1;
-        // printf("Expression type: INT, value: %d\n", $1); // for debugging
+        $$ = default_expr_error_value();
+        $$.type = TYPE_INT;
+        $$.known = true;
+        $$.intValue = $1;
     }
     | REAL {
-        $$.type = "REAL";
-        $$.value = malloc(sizeof(float));
-        *(float *)$$.value = $1;
-        // printf("Expression type: REAL, value: %f\n", $1); // for debugging
+        $$ = default_expr_error_value();
+        $$.type = TYPE_REAL;
+        $$.known = true;
+        $$.realValue = $1;
     }
     | BOOL {
-        $$.type = "BOOL";
-        $$.value = malloc(sizeof(bool));
-        *(bool *)$$.value = $1;
-        // printf("Expression type: BOOL, value: %s\n", $1 ? "true" : "false"); // for debugging
+        $$ = default_expr_error_value();
+        $$.type = TYPE_BOOL;
+        $$.known = true;
+        $$.boolValue = $1;
     }
     | STRING {
-        $$.type = "STRING";
-        $$.value = strdup($1);
-        // printf("Expression type: STRING, value: %s\n", $1); // for debugging
+        $$ = default_expr_error_value();
+        $$.type = TYPE_STRING;
+        $$.known = true;
+        $$.stringValue = unquoteString(ctx, $1);
     }
     | ID {
-        Symbol *symbol = lookupSymbol(currentTable, $1);
+        $$ = default_expr_error_value();
+        Symbol *symbol = lookupSymbol(ctx->symbolTable, $1);
         if (!symbol) {
-            yyerror("Variable not declared");
-            $$ = default_expr_error_value(); // Set to error value
+            yyerror(ctx, "Variable not declared");
+        } else if (symbol->value.known) {
+            $$ = symbol->value; // a const, folded like a literal
         } else {
-            if (strcmp(symbol->type, "int") == 0) {
-                $$.type = "INT";
-            } else if (strcmp(symbol->type, "float") == 0 || strcmp(symbol->type, "double") == 0) {
-                $$.type = "REAL";
-            } else if (strcmp(symbol->type, "bool") == 0) {
-                $$.type = "BOOL";
-            } else if (strcmp(symbol->type, "string") == 0 || strcmp(symbol->type, "char") == 0) {
-            }
+            loadVariable(ctx, symbol);
+            $$.type = exprTypeOf(symbol->type);
         }
     }
     | arithmetic_expression
     | function_invocation {
         // void function(procedure) has no return value
-        if (strcmp($1.type, "void") == 0) {
-            yyerror("Void function cannot be used in expression");
-            if ($1.type) {
-                free($1.type); // Free the value if it was allocated
-            }
+        if ($1.type == TYPE_VOID) {
+            yyerror(ctx, "Void function cannot be used in expression");
+            $$ = default_expr_error_value(); // Set to error value
+        } else if ($1.type == TYPE_ERROR) {
+            yyerror(ctx, "Invalid function return type");
             $$ = default_expr_error_value(); // Set to error value
         } else {
-            if (strcmp($1.type, "int") == 0) {
-                $$.type = "INT";
-                $$.value = NULL;
-                // $$.value = malloc(sizeof(int));
-                // *(int *)$$.value = *(int *)$1.value;
-            } else if (strcmp($1.type, "float") == 0 || strcmp($1.type, "double") == 0) {
-                $$.type = "REAL";
-                $$.value = NULL;
-                // $$.value = malloc(sizeof(float));
-                // *(float *)$$.value = *(float *)$1.value;
-            } else if (strcmp($1.type, "bool") == 0) {
-                $$.type = "BOOL";
-                $$.value = NULL;
-                // $$.value = malloc(sizeof(bool));
-                // *(bool *)$$.value = *(bool *)$1.value;
-            } else if (strcmp($1.type, "string") == 0 || strcmp($1.type, "char") == 0) {
-                $$.type = "STRING";
-                $$.value = NULL;
-                // $$.value = strdup((char *)$1.value);
-            } else {
-                yyerror("Invalid function return type");
-                $$ = default_expr_error_value(); // Set to error value
-            }
-            if ($1.value) {
-                free($1.value); // Free the value if it was allocated
-            }
+            $$ = $1;
         }
     }
     ;
 
 assignment:
     ID OP_ASSIGN expression DELIM_SEMICOLON {   
-        Symbol *symbol = lookupSymbol(currentTable, $1);
+        Symbol *symbol = lookupSymbol(ctx->symbolTable, $1);
         if (!symbol) {
-            yyerror("Variable not declared");
+            yyerror(ctx, "Variable not declared");
+            dropValue(ctx, $3);
         } else if (symbol->isConst) {
-            yyerror("Cannot assign to a constant variable");
+            yyerror(ctx, "Cannot assign to a constant variable");
+            dropValue(ctx, $3);
         } else {
             bool type_match_exact = false;
             bool type_compatible_with_warning = false;
 
             // check if the type of the variable matches the type of the expression
-            if (strcmp(symbol->type, "int") == 0 && strcmp($3.type, "INT") == 0) {
-                // // int to int assignment
-                type_match_exact = true;
-                // symbol->value.intValue = *(int *)$3.value;
-            } else if ((strcmp(symbol->type, "float") == 0) || (strcmp(symbol->type, "double") == 0) && strcmp($3.type, "REAL") == 0) {
-                // // float to float assignment
+            ExprType variableType = exprTypeOf(symbol->type);
+            if (variableType == $3.type) {
                 type_match_exact = true;
-                // symbol->value.realValue = *(float *)$3.value;
-            } else if (strcmp(symbol->type, "bool") == 0 && strcmp($3.type, "BOOL") == 0) {
-                // // bool to bool assignment
-                type_match_exact = true;
-                // symbol->value.boolValue = *(bool *)$3.value;
-            } else if ((strcmp(symbol->type, "char") == 0) || (strcmp(symbol->type, "string") == 0) && strcmp($3.type, "STRING") == 0) {
-                // // string to string assignment
-                type_match_exact = true;
-                // free(symbol->value.stringValue); // free old value
-                // symbol->value.stringValue = strdup((char *)$3.value);
-            } 
-            else if ((strcmp(symbol->type, "float") == 0 || strcmp(symbol->type, "double") == 0) && strcmp($3.type, "INT") == 0) {
+            } else if (variableType == TYPE_REAL && $3.type == TYPE_INT) {
                 // Assigning int to float/double
                 type_compatible_with_warning = true;
-                yywarning("Implicit conversion from int to float/double in assignment");
-                // symbol->value.realValue = (float)(*(int *)$3.value);
-            } else if (strcmp(symbol->type, "int") == 0 && strcmp($3.type, "REAL") == 0) {
+                yywarning(ctx, "Implicit conversion from int to float/double in assignment");
+            } else if (variableType == TYPE_INT && $3.type == TYPE_REAL) {
                 // Assigning float/double to int
                 type_compatible_with_warning = true;
-                yywarning("Implicit conversion from float/double to int in assignment (May cause data loss)");
-                // symbol->value.realValue = *(float *)$3.value;
+                yywarning(ctx, "Implicit conversion from float/double to int in assignment (May cause data loss)");
             }
             
             if (!type_match_exact && !type_compatible_with_warning) {
-                yyerror("Type mismatch in assignment");
-            } 
-            
-        if ($3.value)
-            free($3.value); // release value of expression
+                yyerror(ctx, "Type mismatch in assignment");
+                dropValue(ctx, $3);
+            } else {
+                pushValue(ctx, $3, variableType);
+                storeVariable(ctx, symbol);
+            }
         }
     }
     ;
 
 statements:
-    statement statements
+    statements statement
     | /* empty */
     ;
 
@@ -788,17 +1008,13 @@ statement:
 
 block:
     DELIM_LBRACE {
-        //create a new symbol table for block
-        SymbolTable *newTable = createSymbolTable(currentTable);
-        currentTable = newTable;
+        // open a scope for the block
+        enterScope(ctx->symbolTable);
     }
     statements
     DELIM_RBRACE{
-        // dump and delete the current symbol table, currnet table set to parent table
-        SymbolTable *parentTable = currentTable->parent;
-        dumpSymbolTable(currentTable);
-        deleteSymbolTable(currentTable);
-        currentTable = parentTable;
+        // dump the scope's symbols and drop them
+        exitScope(ctx->symbolTable, &ctx->diag);
     }
     ;
 
@@ -807,73 +1023,55 @@ simple:
     | print
     | increment_decrement
     | semicolon_only
-    | arithmetic_expression DELIM_SEMICOLON
-    | function_invocation DELIM_SEMICOLON
+    | arithmetic_expression DELIM_SEMICOLON {
+        dropValue(ctx, $1);
+    }
+    | function_invocation DELIM_SEMICOLON {
+        dropValue(ctx, $1); // the result, if the function has one
+    }
     ;
 
 print:
-    KW_PRINT expression DELIM_SEMICOLON {
-        // printf("Print statement: %s\n", $2); // for debugging
-        if (strcmp($2.type, "INT") == 0) {
-            // printf("%d", *(int *)$2.value);
-        } else if (strcmp($2.type, "REAL") == 0) {
-            // printf("%f", *(float *)$2.value);
-        } else if (strcmp($2.type, "BOOL") == 0) {
-            // printf("%s", *(bool *)$2.value ? "true" : "false");
-        } else if (strcmp($2.type, "STRING") == 0) {
-            // printf("%s", (char *)$2.value);
-        } else {
-            yyerror("Invalid type for print statement");
-        }
+    KW_PRINT {
+        ctx->codeGen->emitFieldInstruction(OP_GETSTATIC, "java.io.PrintStream", "java.lang.System", "out");
+    } expression DELIM_SEMICOLON {
+        emitPrint(ctx, $3, "print");
     }
-    | KW_PRINTLN expression DELIM_SEMICOLON {
-        // printf("Println statement: %s\n", $2); // for debugging
-        if (strcmp($2.type, "INT") == 0) {
-            // printf("%d\n", *(int *)$2.value);
-        } else if (strcmp($2.type, "REAL") == 0) {
-            // printf("%f\n", *(float *)$2.value);
-        } else if (strcmp($2.type, "BOOL") == 0) {
-            // printf("%s\n", *(bool *)$2.value ? "true" : "false");
-        } else if (strcmp($2.type, "STRING") == 0) {
-            // printf("%s\n", (char *)$2.value);
-        } else {
-            yyerror("Invalid type for println statement");
-        }
+    | KW_PRINTLN {
+        ctx->codeGen->emitFieldInstruction(OP_GETSTATIC, "java.io.PrintStream", "java.lang.System", "out");
+    } expression DELIM_SEMICOLON {
+        emitPrint(ctx, $3, "println");
     }
     ;
 
 increment_decrement:
     ID OP_INC DELIM_SEMICOLON {
         // printf("Increment statement: %s\n", $1); // for debugging
-        Symbol *symbol = lookupSymbol(currentTable, $1);
+        Symbol *symbol = lookupSymbol(ctx->symbolTable, $1);
         if (!symbol) {
-            yyerror("Variable not declared");
+            yyerror(ctx, "Variable not declared");
         } else if (symbol->isConst) {
-            yyerror("Cannot assign to a constant variable");
+            yyerror(ctx, "Cannot assign to a constant variable");
         } else {
-            if (strcmp(symbol->type, "int") == 0) {
-                // symbol->value.intValue++;
-            } else if (strcmp(symbol->type, "float") == 0 || strcmp(symbol->type, "double") == 0) {
-                // symbol->value.realValue++;
+            if (exprTypeOf(symbol->type) == TYPE_INT || exprTypeOf(symbol->type) == TYPE_REAL) {
+                incrementVariable(ctx, symbol, 1);
             } else {
-                yyerror("Invalid type for increment statement");
+                yyerror(ctx, "Invalid type for increment statement");
             }
         }
     }
     | ID OP_DEC DELIM_SEMICOLON {
         // printf("Decrement statement: %s\n", $1); // for debugging
-        Symbol *symbol = lookupSymbol(currentTable, $1);
+        Symbol *symbol = lookupSymbol(ctx->symbolTable, $1);
         if (!symbol) {
-            yyerror("Variable not declared");
+            yyerror(ctx, "Variable not declared");
         } else if (symbol->isConst) {
-            yyerror("Cannot assign to a constant variable");
+            yyerror(ctx, "Cannot assign to a constant variable");
         } else {
-            if (strcmp(symbol->type, "int") == 0) {
-                // int decrement
-            } else if (strcmp(symbol->type, "float") == 0 || strcmp(symbol->type, "double") == 0) {
-                // real decrement
+            if (exprTypeOf(symbol->type) == TYPE_INT || exprTypeOf(symbol->type) == TYPE_REAL) {
+                incrementVariable(ctx, symbol, -1);
             } else {
-                yyerror("Invalid type for decrement statement");
+                yyerror(ctx, "Invalid type for decrement statement");
             }
         }
     }
@@ -883,136 +1081,91 @@ semicolon_only:
     DELIM_SEMICOLON
     ;
 
-conditional:
-    KW_IF DELIM_LPAR expression DELIM_RPAR simple {
-        // printf("If statement: %s\n", $3); // for debugging
-        if (strcmp($3.type, "BOOL") == 0) {
-            // if (*(bool *)$3.value) {
-            //     // execute simple statement
-            // } else {
-            //     // skip simple statement
-            // }
-        } else {
-            yyerror("Invalid type for if condition");
-        }
+// a foreach bound; the loop isn't run yet, so its value is taken off the
+// stack before the body
+control_expression:
+    expression {
+        dropValue(ctx, $1);
+        $$ = $1;
     }
-    | KW_IF DELIM_LPAR expression DELIM_RPAR block {
-        // printf("If statement\n"); // for debugging
-        if (strcmp($3.type, "BOOL") == 0) {
-            // if (*(bool *)$3.value) {
-            //     // execute block
-            // } else {
-            //     // skip block
-            // }
+    ;
+
+// a bool an if or a loop tests, in jump form: it goes to falseLabel when
+// it is false (if it can be) and falls through when it is true
+condition:
+    expression {
+        $$ = default_expr_error_value();
+        $$.type = $1.type;
+        if ($1.type == TYPE_BOOL) {
+            $$.falseLabel = jumpWhen(ctx, $1, false);
         } else {
-            yyerror("Invalid type for if condition");
+            dropValue(ctx, $1);
         }
     }
-    | KW_IF DELIM_LPAR expression DELIM_RPAR simple KW_ELSE simple {
-        // printf("If-else statement\n"); // for debugging
-        if (strcmp($3.type, "BOOL") == 0) {
-            // if (*(bool *)$3.value) {
-            //     // execute first block
-            // } else {
-            //     // execute second block
-            // }
-        } else {
-            yyerror("Invalid type for if condition");
-        }
+    ;
+
+conditional:
+    if_head simple {
+        placeLabel(ctx, $1);
     }
-    | KW_IF DELIM_LPAR expression DELIM_RPAR simple KW_ELSE block {
-        // printf("If-else statement\n"); // for debugging
-        if (strcmp($3.type, "BOOL") == 0) {
-            // if (*(bool *)$3.value) {
-            //     // execute first block
-            // } else {
-            //     // execute second block
-            // }
-        } else {
-            yyerror("Invalid type for if condition");
-        }
+    | if_head block {
+        placeLabel(ctx, $1);
     }
-    | KW_IF DELIM_LPAR expression DELIM_RPAR block KW_ELSE simple {
-        // printf("If-else statement\n"); // for debugging
-        if (strcmp($3.type, "BOOL") == 0) {
-            // if (*(bool *)$3.value) {
-            //     // execute first block
-            // } else {
-            //     // execute second block
-            // }
-        } else {
-            yyerror("Invalid type for if condition");
-        }
+    | if_else_head simple {
+        placeLabel(ctx, $1);
     }
-    | KW_IF DELIM_LPAR expression DELIM_RPAR block KW_ELSE block {
-        // printf("If-else statement\n"); // for debugging
-        if (strcmp($3.type, "BOOL") == 0) {
-            // if (*(bool *)$3.value) {
-            //     // execute first block
-            // } else {
-            //     // execute second block
-            // }
-        } else {
-            yyerror("Invalid type for if condition");
+    | if_else_head block {
+        placeLabel(ctx, $1);
+    }
+    ;
+
+// leaves the label the condition jumps to when it is false
+if_head:
+    KW_IF DELIM_LPAR condition DELIM_RPAR {
+        if ($3.type != TYPE_BOOL) {
+            yyerror(ctx, "Invalid type for if condition");
         }
+        $$ = $3.falseLabel;
+    }
+    ;
+
+// the then part jumps over the else part, to the label this leaves
+if_else_head:
+    if_head simple KW_ELSE {
+        $$ = skipElse(ctx, $1);
+    }
+    | if_head block KW_ELSE {
+        $$ = skipElse(ctx, $1);
     }
     ;
 
 loop:
-    KW_WHILE DELIM_LPAR expression DELIM_RPAR simple {
-        // printf("While statement: %s\n", $3); // for debugging
-        if (strcmp($3.type, "BOOL") == 0) {
-            // while (*(bool *)$3.value) {
-            //     // execute simple statement
-            // }
-        } else {
-            yyerror("Invalid type for while condition");
-        }
+    while_head simple {
+        endLoop(ctx, $1);
     }
-    | KW_WHILE DELIM_LPAR expression DELIM_RPAR block {
-        // printf("While statement\n"); // for debugging
-        if (strcmp($3.type, "BOOL") == 0) {
-            // while (*(bool *)$3.value) {
-            //     // execute block
-            // }
-        } else {
-            yyerror("Invalid type for while condition");
-        }
+    | while_head block {
+        endLoop(ctx, $1);
     }
-    | KW_FOR DELIM_LPAR simple DELIM_SEMICOLON expression DELIM_SEMICOLON simple DELIM_RPAR simple {
-        // printf("For statement\n"); // for debugging
-        if (strcmp($5.type, "BOOL") == 0) {
-            // while (*(bool *)$5.value) {
-            //     // execute simple statement
-            // }
-        } else {
-            yyerror("Invalid type for for condition");
-        }
+    | for_head simple {
+        endLoop(ctx, $1);
     }
-    | KW_FOR DELIM_LPAR simple DELIM_SEMICOLON expression DELIM_SEMICOLON simple DELIM_RPAR block {
-        // printf("For statement\n"); // for debugging
-        if (strcmp($5.type, "BOOL") == 0) {
-            // while (*(bool *)$5.value) {
-            //     // execute simple statement
-            // }
-        } else {
-            yyerror("Invalid type for for condition");
-        }
+    | for_head block {
+        endLoop(ctx, $1);
     }
-    | KW_FOREACH DELIM_LPAR ID DELIM_COLON expression DELIM_DOT DELIM_DOT expression DELIM_RPAR simple {
-        if (strcmp($5.type, "INT") != 0 || strcmp($8.type, "INT") != 0) {
-            yyerror("Foreach range must be integers");
+    | KW_FOREACH DELIM_LPAR ID DELIM_COLON control_expression DELIM_DOT DELIM_DOT control_expression DELIM_RPAR simple {
+        if ($5.type != TYPE_INT || $8.type != TYPE_INT) {
+            yyerror(ctx, "Foreach range must be integers");
         } else {
             // int start = *(int *)$5.value;
             // int end = *(int *)$7.value;
 
             // for (int i = start; i <= end; i++) {
             //     // execute simple statement
-            //     Symbol *symbol = lookupSymbol(currentTable, $3);
+            //     Symbol *symbol = lookupSymbol(ctx->symbolTable, $3);
             //     if (!symbol) {
-            //         yyerror("Variable not declared");
+            //         yyerror(ctx, "Variable not declared");
             //     } else if (symbol->isConst) {
-            //         yyerror("Cannot assign to a constant variable");
+            //         yyerror(ctx, "Cannot assign to a constant variable");
             //     } else {
             //         symbol->value.intValue = i;
             //     }
@@ -1020,20 +1173,20 @@ loop:
             // }
         }
     }
-    | KW_FOREACH DELIM_LPAR ID DELIM_COLON expression DELIM_DOT DELIM_DOT expression DELIM_RPAR block {
-        if (strcmp($5.type, "INT") != 0 || strcmp($8.type, "INT") != 0) {
-            yyerror("Foreach range must be integers");
+    | KW_FOREACH DELIM_LPAR ID DELIM_COLON control_expression DELIM_DOT DELIM_DOT control_expression DELIM_RPAR block {
+        if ($5.type != TYPE_INT || $8.type != TYPE_INT) {
+            yyerror(ctx, "Foreach range must be integers");
         } else {
             // int start = *(int *)$5.value;
             // int end = *(int *)$7.value;
 
             // for (int i = start; i <= end; i++) {
             //     // execute simple statement
-            //     Symbol *symbol = lookupSymbol(currentTable, $3);
+            //     Symbol *symbol = lookupSymbol(ctx->symbolTable, $3);
             //     if (!symbol) {
-            //         yyerror("Variable not declared");
+            //         yyerror(ctx, "Variable not declared");
             //     } else if (symbol->isConst) {
-            //         yyerror("Cannot assign to a constant variable");
+            //         yyerror(ctx, "Cannot assign to a constant variable");
             //     } else {
             //         symbol->value.intValue = i;
             //     }
@@ -1043,47 +1196,83 @@ loop:
     }
     ;
 
+// the test is at the top, so the body goes back to it
+while_head:
+    KW_WHILE {
+        $<intval>$ = ctx->codeGen->newLabel();
+        ctx->codeGen->emitLabel($<intval>$);
+    } DELIM_LPAR condition DELIM_RPAR {
+        if ($4.type != TYPE_BOOL) {
+            yyerror(ctx, "Invalid type for while condition");
+        }
+        $$.repeat = $<intval>2;
+        $$.exit = $4.falseLabel;
+    }
+    ;
+
+// The step is parsed before the body but runs after it, so the test
+// jumps over it into the body, and the body goes back to it:
+// init; test: condition; goto body; step: step; goto test; body: ...
+for_head:
+    KW_FOR DELIM_LPAR simple DELIM_SEMICOLON {
+        $<intval>$ = ctx->codeGen->newLabel();
+        ctx->codeGen->emitLabel($<intval>$);
+    } condition DELIM_SEMICOLON {
+        $<loop>$.exit = ctx->codeGen->newLabel(); // where the body starts
+        if (ctx->codeGen->reachable()) {
+            ctx->codeGen->emitBranch(OP_GOTO, $<loop>$.exit);
+        }
+        $<loop>$.repeat = ctx->codeGen->newLabel();
+        ctx->codeGen->emitLabel($<loop>$.repeat);
+    } simple DELIM_RPAR {
+        if ($6.type != TYPE_BOOL) {
+            yyerror(ctx, "Invalid type for for condition");
+        }
+        if (ctx->codeGen->reachable()) {
+            ctx->codeGen->emitBranch(OP_GOTO, $<intval>5);
+        }
+        ctx->codeGen->emitLabel($<loop>8.exit);
+        $$.repeat = $<loop>8.repeat;
+        $$.exit = $6.falseLabel;
+    }
+    ;
+
 return_statement:
     KW_RETURN expression DELIM_SEMICOLON {
-        if (current_function_return_type_for_return_check != NULL) { // inside a function
-            if (strcmp(current_function_return_type_for_return_check, "void") == 0) {
-                yyerror("Void function cannot return a value");
+        bool return_emitted = false;
+        if (ctx->current_function_return_type_for_return_check != NULL) { // inside a function
+            if (exprTypeOf(ctx->current_function_return_type_for_return_check) == TYPE_VOID) {
+                yyerror(ctx, "Void function cannot return a value");
             } else { // non-void function
-                bool type_match = false;
-                char *func_return_type_str = current_function_return_type_for_return_check;
-                char *expr_type_str = $2.type;
-
                 // compare funciton's declared return type with the expression's type
-                if (strcmp(func_return_type_str, "int") == 0 && strcmp(expr_type_str, "INT") == 0) {
-                    type_match = true;
-                } else if ((strcmp(func_return_type_str, "float") == 0 || strcmp(func_return_type_str, "double") == 0) && strcmp(expr_type_str, "REAL") == 0) {
-                    type_match = true;
-                } else if (strcmp(func_return_type_str, "bool") == 0 && strcmp(expr_type_str, "BOOL") == 0) {
-                    type_match = true;
-                } else if ((strcmp(func_return_type_str, "char") == 0 || strcmp(func_return_type_str, "string") == 0) && strcmp(expr_type_str, "STRING") == 0) {
-                    type_match = true;
-                }
+                bool type_match = exprTypeOf(ctx->current_function_return_type_for_return_check) == $2.type;
 
                 if (!type_match) {
-                    yyerror("Return type mismatch in function");
+                    yyerror(ctx, "Return type mismatch in function");
                 } else {
-                    non_void_function_has_return_value_statement = true; // set flag to true
+                    ctx->non_void_function_has_return_value_statement = true; // set flag to true
+                    pushValue(ctx, $2, $2.type);
+                    emitValueReturn(ctx, ctx->current_function_return_type_for_return_check);
+                    return_emitted = true;
                 }
             }
         } else {
-            yyerror("Return statement outside of a function.");
+            yyerror(ctx, "Return statement outside of a function.");
+        }
+        if (!return_emitted) {
+            dropValue(ctx, $2);
         }
     }
     | KW_RETURN DELIM_SEMICOLON { // return; (without an expression)
-        if (current_function_return_type_for_return_check != NULL) { // Inside a function
-            if (strcmp(current_function_return_type_for_return_check, "void") == 0) {
+        if (ctx->current_function_return_type_for_return_check != NULL) { // Inside a function
+            if (exprTypeOf(ctx->current_function_return_type_for_return_check) == TYPE_VOID) {
                 // void function must not have a return statement"
-                yyerror("Void function cannot have any return statement");
+                yyerror(ctx, "Void function cannot have any return statement");
             } else { // Non-void function
-                yyerror("Non-void function must return a value");
+                yyerror(ctx, "Non-void function must return a value");
             }
         } else {
-            yyerror("Return statement outside of a function.");
+            yyerror(ctx, "Return statement outside of a function.");
         }
     }
     ;
@@ -1091,241 +1280,187 @@ return_statement:
 function_declaration:
     type_specifier ID DELIM_LPAR parameter_list DELIM_RPAR DELIM_LBRACE {
         // check if the function is already declared
-        if (lookupFunction(functionTable, $2)) {
-            yyerror("Function already declared");
+        if (lookupFunction(ctx->functionTable, $2)) {
+            yyerror(ctx, "Function already declared");
         } else {
             // check if parameter list has duplicate names
-            Parameter *param = $4;
-            std::string paramStr;
-            while (param != NULL) {
-                Parameter *nextParam = param->next;
-                while (nextParam != NULL) {
-                    if (strcmp(param->name, nextParam->name) == 0) {
-                        yyerror("Duplicate parameter name in function declaration");
+            for (Parameter *param = $4.head; param != NULL; param = param->next) {
+                for (Parameter *other = param->next; other != NULL; other = other->next) {
+                    if (param->name == other->name) {
+                        yyerror(ctx, "Duplicate parameter name in function declaration");
                     }
-                    nextParam = nextParam->next;
-                }
-
-                if (!paramStr.empty()) {
-                    paramStr += ", ";
-                }
-                if (param->type) {
-                    paramStr += param->type;
                 }
-                // if (param->name) {
-                //     paramStr += " ";
-                //     paramStr += param->name;
-                // }
-
-                param = param->next;
-                if (param != NULL) // Avoid dereferencing NULL pointer
-                    nextParam = param->next;
             }
             // add function to the function table
-            insertFunction(functionTable, $2, $1, $4);
+            Function *function = insertFunction(ctx->functionTable, $2, $1, $4.head);
 
             // code generation
-            codeGen->emitMethod($2, $1, paramStr);
-            codeGen->emitMethodStart();
+            ctx->codeGen->emitMethod(function);
+            ctx->codeGen->emitMethodStart();
 
-            current_function_name_for_return_check = $2;
-            current_function_return_type_for_return_check = $1; // store the declared return type
-            non_void_function_has_return_value_statement = false; // reset for this function
+            ctx->current_function_name_for_return_check = $2;
+            ctx->current_function_return_type_for_return_check = $1; // store the declared return type
+            ctx->non_void_function_has_return_value_statement = false; // reset for this function
         }
-        //create a new symbol table for block
-        SymbolTable *newTable = createSymbolTable(currentTable);
-        currentTable = newTable;
+        // open a scope for the body
+        enterScope(ctx->symbolTable);
         // add all arguments to the symbol table
-        Parameter *param = $4;
+        Parameter *param = $4.head;
         while (param != NULL) {
-            insertSymbol(currentTable, param->name, param->type, 0);
+            insertSymbol(ctx->symbolTable, param->name, param->type, 0);
             param = param->next;
         }
+        // the body's values go when it ends
+        ctx->functionMark = arenaMark(ctx->arena);
     }
     statements
     DELIM_RBRACE {
         // check if funciton has return statement
-        if (strcmp(current_function_return_type_for_return_check, "void") != 0) {
-            if (!non_void_function_has_return_value_statement) {
-                yyerror("Non-void function must have a return statement");
+        if (exprTypeOf(ctx->current_function_return_type_for_return_check) != TYPE_VOID) {
+            if (!ctx->non_void_function_has_return_value_statement) {
+                yyerror(ctx, "Non-void function must have a return statement");
             }
         }
-        // dump and delete the current symbol table, currnet table set to parent table
-        SymbolTable *parentTable = currentTable->parent;
-        dumpSymbolTable(currentTable);
-        deleteSymbolTable(currentTable);
-        currentTable = parentTable;
+        // dump the scope's symbols and drop them
+        exitScope(ctx->symbolTable, &ctx->diag);
 
         // code generation
-        // TODO: return code generation
-        codeGen->emitMethodEnd();
+        // a body that can run off its end returns zero (or null)
+        if (ctx->current_function_return_type_for_return_check != NULL && ctx->codeGen->reachable()) {
+            pushDefault(ctx, exprTypeOf(ctx->current_function_return_type_for_return_check));
+            emitValueReturn(ctx, ctx->current_function_return_type_for_return_check);
+        }
+        ctx->codeGen->emitMethodEnd();
 
         // clear function helpsers
-        current_function_name_for_return_check = NULL;
-        current_function_return_type_for_return_check = NULL;
+        ctx->current_function_name_for_return_check = NULL;
+        ctx->current_function_return_type_for_return_check = NULL;
+        arenaRelease(ctx->arena, ctx->functionMark); // reduced with no lookahead token pending
     }
     | KW_VOID ID DELIM_LPAR parameter_list DELIM_RPAR DELIM_LBRACE {
         // check if the function is already declared
-        if (lookupFunction(functionTable, $2)) {
-            yyerror("Function already declared");
+        if (lookupFunction(ctx->functionTable, $2)) {
+            yyerror(ctx, "Function already declared");
         } else {
             // check if parameter list has duplicate names
-            Parameter *param = $4;
-            std::string paramStr;
-            while (param != NULL) {
-                Parameter *nextParam = param->next;
-                while (nextParam != NULL) {
-
-                    if (strcmp(param->name, nextParam->name) == 0) {
-                        yyerror("Duplicate parameter name in function declaration");
+            for (Parameter *param = $4.head; param != NULL; param = param->next) {
+                for (Parameter *other = param->next; other != NULL; other = other->next) {
+                    if (param->name == other->name) {
+                        yyerror(ctx, "Duplicate parameter name in function declaration");
                     }
-                    nextParam = nextParam->next;
-                }
-
-                if (!paramStr.empty()) {
-                    paramStr += ", ";
                 }
-                if (param->type) {
-                    paramStr += param->type;
-                }
-                // if (param->name) {
-                //     paramStr += " ";
-                //     paramStr += param->name;
-                // }
-
-                param = param->next;
-                if (param != NULL) // Avoid dereferencing NULL pointer
-                    nextParam = param->next;
             }
             // add function to the function table
-            insertFunction(functionTable, $2, "void", $4);
+            Function *function = insertFunction(ctx->functionTable, $2, ctx->typeNames[TYPE_VOID], $4.head);
 
             // code generation
-            codeGen->emitMethod($2, "void", paramStr);
-            codeGen->emitMethodStart();
+            ctx->codeGen->emitMethod(function);
+            ctx->codeGen->emitMethodStart();
 
-            current_function_name_for_return_check = $2;
-            current_function_return_type_for_return_check = "void"; // store the declared return type
-            non_void_function_has_return_value_statement = false; // reset for this function
+            ctx->current_function_name_for_return_check = $2;
+            ctx->current_function_return_type_for_return_check = ctx->typeNames[TYPE_VOID]; // store the declared return type
+            ctx->non_void_function_has_return_value_statement = false; // reset for this function
         }
-        //create a new symbol table for block
-        SymbolTable *newTable = createSymbolTable(currentTable);
-        currentTable = newTable;
+        // open a scope for the body
+        enterScope(ctx->symbolTable);
         // add all arguments to the symbol table
-        Parameter *param = $4;
+        Parameter *param = $4.head;
         while (param != NULL) {
-            insertSymbol(currentTable, param->name, param->type, 0);
+            insertSymbol(ctx->symbolTable, param->name, param->type, 0);
             param = param->next;
         }
+        // the body's values go when it ends
+        ctx->functionMark = arenaMark(ctx->arena);
     }
     statements
     DELIM_RBRACE {
         // for void function, check it has no return statement
         // will be handled in "return_statement" rule
 
-        // dump and delete the current symbol table, currnet table set to parent table
-        SymbolTable *parentTable = currentTable->parent;
-        dumpSymbolTable(currentTable);
-        deleteSymbolTable(currentTable);
-        currentTable = parentTable;
+        // dump the scope's symbols and drop them
+        exitScope(ctx->symbolTable, &ctx->diag);
 
         // code generation
-        codeGen->emitMethodEnd();
+        if (ctx->codeGen->reachable()) {
+            ctx->codeGen->emitReturn();
+        }
+        ctx->codeGen->emitMethodEnd();
 
-        current_function_name_for_return_check = NULL;
-        current_function_return_type_for_return_check = NULL;
+        ctx->current_function_name_for_return_check = NULL;
+        ctx->current_function_return_type_for_return_check = NULL;
+        arenaRelease(ctx->arena, ctx->functionMark); // reduced with no lookahead token pending
     }
     ;
 
-parameter_list: 
+parameter:
     type_specifier ID {
-        // single parameter
-        $$ = (Parameter *)malloc(sizeof(Parameter));
-        $$->name = strdup($2);
-        $$->type = strdup($1);
+        $$ = (Parameter *)arenaAlloc(ctx->arena, sizeof(Parameter));
+        $$->name = $2;
+        $$->type = $1;
         $$->next = NULL;
     }
-    | type_specifier ID DELIM_COMMA parameter_list {
+    ;
+
+parameters:
+    parameter {
+        // single parameter
+        $$.head = $$.tail = $1;
+    }
+    | parameters DELIM_COMMA parameter {
         // multiple parameters
-        $$ = (Parameter *)malloc(sizeof(Parameter));
-        $$->name = strdup($2);
-        $$->type = strdup($1);
-        $$->next = $4;
+        $$ = $1;
+        $$.tail->next = $3;
+        $$.tail = $3;
+    }
+    ;
+
+parameter_list:
+    parameters {
+        $$ = $1;
     }
     | /* empty */ {
         // no parameters
-        $$ = NULL;
+        $$.head = $$.tail = NULL;
     }
     ;
 
 function_invocation:
-    ID DELIM_LPAR argument_list DELIM_RPAR {
+    ID DELIM_LPAR {
+        // the arguments are pushed as they are parsed
+        $<call>$ = ctx->call;
+        ctx->call.function = lookupFunction(ctx->functionTable, $1);
+        ctx->call.argument = 0;
+    } argument_list DELIM_RPAR {
         // check if the function is declared
         $$ = default_expr_error_value();
-        Function *func = lookupFunction(functionTable, $1);
+        const Function *func = ctx->call.function;
+        ctx->call = $<call>3;
         if (!func) {
-            yyerror("Function not declared");
+            yyerror(ctx, "Function not declared");
         } else {
-            // check if the number of arguments matches the number of parameters
+            // check the arguments against the signature in one pass
             int numArgs = 0;
-            Parameter *arg = $3;
-            while (arg != NULL) {
-                numArgs++;
-                arg = arg->next;
-            }
-            int numParams = 0;
-            Parameter *param = func->parameters;
-            while (param != NULL) {
-                numParams++;
-                param = param->next;
+            bool type_mismatch = false;
+            for (Parameter *arg = $4.head; arg != NULL; arg = arg->next, numArgs++) {
+                if (numArgs < func->arity && exprTypeOf(arg->type) != exprTypeOf(func->paramTypes[numArgs])) {
+                    type_mismatch = true;
+                }
             }
-            if (numArgs != numParams) {
-                yyerror("Number of arguments does not match number of parameters");
+            if (numArgs != func->arity) {
+                yyerror(ctx, "Number of arguments does not match number of parameters");
+            } else if (type_mismatch) {
+                yyerror(ctx, "Type mismatch in function invocation");
             } else {
-                // check if the types of arguments match the types of parameters
-                arg = $3;
-                param = func->parameters;
-                bool type_mismatch = false;
-                int arg_count = 0;
-                while (arg != NULL && param != NULL) {
-                    arg_count++;
-                    bool current_arg_type_match = false;
-                    if (strcmp(arg->type, "INT") == 0 && strcmp(param->type, "int") == 0) {
-                        current_arg_type_match = true;
-                    } else if (strcmp(arg->type, "REAL") == 0 && (strcmp(param->type, "string") == 0 || strcmp(param->type, "double") == 0)) {
-                        current_arg_type_match = true;
-                    } else if (strcmp(arg->type, "BOOL") == 0 && strcmp(param->type, "bool") == 0) {
-                        current_arg_type_match = true;
-                    } else if (strcmp(arg->type, "STRING") == 0 && (strcmp(param->type, "string") == 0 || strcmp(param->type, "char") == 0)) {
-                        current_arg_type_match = true;
-                    }
-                    if (!current_arg_type_match) {
-                        type_mismatch = true;
-                        yyerror("Type mismatch in function invocation");
-                        break; // exit the loop on type mismatch
-                    }
-                    arg = arg->next;
-                    param = param->next;
-                }
-                if (!type_mismatch) {
-                    // function invocation is valid
-                    $$.type = strdup(func->type);
-                    if (strcmp(func->type, "void") == 0) {
-                        $$.value = NULL; // void function has no return value
-                    } else {
-                        $$.value = NULL; // no need to store value
-                    }
+                // function invocation is valid
+                ctx->codeGen->emitInvokeStatic(func->name);
+                if (isDouble(func->type)) {
+                    ctx->codeGen->emitInstruction(OP_D2F);
                 }
+                $$.type = exprTypeOf(func->type); // its value is not known
             }
-            Parameter *temp_arg = $3;
-            while (temp_arg != NULL) {
-                Parameter *next_arg = temp_arg->next;
-                if (temp_arg->type)
-                    free(temp_arg->type);
-                // if (temp_arg->value) free(temp_arg->value);
-                free(temp_arg);
-                temp_arg = next_arg;
-            }
+        }
+        if ($$.type == TYPE_ERROR) {
+            dropArguments(ctx, $4.head);
         }
     }
     ;
@@ -1333,27 +1468,21 @@ function_invocation:
 argument_list_actual:
     expression {
         // single argument
-        $$ = (Parameter *)malloc(sizeof(Parameter));
-        if (!$$) {
-            yyerror("Memory allocation failed for argument list");
-            exit(1);
-        }
-        $$->name = NULL; // no name for actual argument
-        $$->type = strdup($1.type);
-        $$->next = NULL;
-
-
+        Parameter *arg = (Parameter *)arenaAlloc(ctx->arena, sizeof(Parameter));
+        arg->name = NULL; // no name for actual argument
+        arg->type = passArgument(ctx, $1); // as a declared type
+        arg->next = NULL;
+        $$.head = $$.tail = arg;
     }
-    | expression DELIM_COMMA argument_list_actual {
+    | argument_list_actual DELIM_COMMA expression {
         // multiple arguments
-        $$ = (Parameter *)malloc(sizeof(Parameter));
-        if (!$$) {
-            yyerror("Memory allocation failed for argument list");
-            exit(1);
-        }
-        $$->name = NULL; // no name for actual argument
-        $$->type = strdup($1.type);
-        $$->next = $3;
+        Parameter *arg = (Parameter *)arenaAlloc(ctx->arena, sizeof(Parameter));
+        arg->name = NULL; // no name for actual argument
+        arg->type = passArgument(ctx, $3); // as a declared type
+        arg->next = NULL;
+        $$ = $1;
+        $$.tail->next = arg;
+        $$.tail = arg;
     }
     ;
 
@@ -1362,58 +1491,137 @@ argument_list:
         $$ = $1;
     }
     | /* empty */ {
-        $$ = NULL;
+        $$.head = $$.tail = NULL;
     }
     ;
     
 %%
 
-int main(int argc, char **argv) {
-    if (argc != 2) {
-        printf("Usage: %s <input file>\n", argv[0]);
-        return 1;
-    }
-
-    yyin = fopen(argv[1], "r");
-    if (!yyin) {
-        perror("fopen");
+// compiles one .sd file to a class named after it; returns 0 on success.
+// All of the compilation's state is in a context of its own, and its
+// errors, the code generator's and the class file's too, are reported
+// there rather than ending the process, so this can run in several
+// threads at once.  Only running out of memory still exits.
+int compileFile(const char *input, const CompileOptions &options) {
+    CompileContext context = {};
+    CompileContext *ctx = &context;
+    // a listing on stdout leaves no room there for messages
+    DiagnosticOptions diagnostics = options.diagnostics;
+    bool listingToStdout = options.listing && options.listingPath && strcmp(options.listingPath, "-") == 0;
+    diagnostics.allToStderr = diagnostics.allToStderr || listingToStdout;
+    initDiagnostics(&ctx->diag, diagnostics, input, &ctx->source);
+    if (!openSource(&ctx->source, input)) {
+        std::string message = std::string("couldn't read ") + input + ": " + strerror(errno);
+        reportMessage(&ctx->diag, DIAG_ERROR, 0, NULL, message.c_str());
+        closeDiagnostics(&ctx->diag);
         return 1;
     }
 
     // get file name
-    std::string filename(argv[1]);
+    std::string filename(input);
     size_t last_dot = filename.find_last_of('.');
     std::string class_name = (last_dot == std::string::npos) ? filename : filename.substr(0, last_dot);
 
+    ctx->linenum = 1;
+    if (yylex_init_extra(ctx, &ctx->scanner) != 0) {
+        perror("yylex_init_extra");
+        closeDiagnostics(&ctx->diag);
+        closeSource(&ctx->source);
+        return 1;
+    }
+    // the text and the two NULs after it
+    yy_scan_buffer(ctx->source.text, ctx->source.length + 2, ctx->scanner);
+    ctx->arena = createArena();
+    ctx->names = createInterner();
+    // type names carry their ExprType as their tag
+    static const char *declaredTypes[] = { "int", "float", "double", "char", "bool", "string", "void" };
+    for (const char *typeName : declaredTypes) {
+        internTagged(ctx->names, typeName, exprTypeFromName(typeName));
+    }
+    for (int type = 0; type < EXPR_TYPE_COUNT; type++) {
+        ctx->typeNames[type] = intern(ctx->names, exprTypeName((ExprType)type));
+    }
+
     // create class code generator
-    codeGen = new CodeGenerator(class_name);
+    ctx->codeGen = new CodeGenerator(class_name, &ctx->diag, options.listing, options.listingPath);
 
-    printf("Starting parsing...\n");
+    reportProgress(&ctx->diag, "Starting parsing...");
 
     // Initialize the symbol table
-    currentTable = createSymbolTable(NULL);
-    functionTable = createFunctionTable();
-
-    // int token;
-    // while ((token = yylex()) != 0) {
-    //     printf("Line%d, Token: %s, Text: %s\n", linenum, token_names[token - 258], yytext);
-    // }
-
-    if (yyparse() == 0) {
-        // Dump and delete globol symbol table
-        dumpSymbolTable(currentTable);
-        deleteSymbolTable(currentTable);
-        currentTable = NULL;
-        deleteFunctionTable(functionTable);
-        functionTable = NULL;
-        delete codeGen;
-        codeGen = NULL;
-        printf("Parsing done.\n");
-    } else {
-        printf("Parsing failed.\n");
+    ctx->symbolTable = createSymbolTable();
+    ctx->functionTable = createFunctionTable();
+
+    bool parsed = yyparse(ctx->scanner, ctx) == 0;
+    if (parsed) {
+        // Dump the globol symbol table
+        dumpSymbolTable(ctx->symbolTable, &ctx->diag);
+    }
+    // the parse may have stopped inside a function, a few scopes deep
+    deleteSymbolTable(ctx->symbolTable);
+    ctx->symbolTable = NULL;
+    deleteFunctionTable(ctx->functionTable);
+    ctx->functionTable = NULL;
+    // a program with errors, syntax or semantic, gets no class
+    if (!parsed || ctx->diag.errors > 0) {
+        ctx->codeGen->discard();
+    }
+    delete ctx->codeGen; // which can fail to write the class
+    ctx->codeGen = NULL;
+    int result = (parsed && ctx->diag.errors == 0) ? 0 : 1;
+    reportProgress(&ctx->diag, parsed ? "Parsing done." : "Parsing failed.");
+
+    yylex_destroy(ctx->scanner);
+    deleteArena(ctx->arena);
+    deleteInterner(ctx->names);
+    deleteSpanTable(&ctx->tokens);
+    closeDiagnostics(&ctx->diag);
+    closeSource(&ctx->source);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    // -S also writes the generated class as a .jasm listing, and -o PATH
+    // writes it to PATH instead; -o - streams it to stdout for javaa
+    // (parser -o - prog.sd | javaa -), with every message on stderr.  -j N
+    // and more than one input (or a directory of .sd files) compile in
+    // batch mode.  -v adds every scope's symbols and every comment to the
+    // output, -q leaves only errors and warnings, and --json writes JSON
+    // lines
+    CompileOptions options = { false, NULL, { DIAG_PROGRESS, false, false, NULL } };
+    int jobs = 0;
+    bool batch = false;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-S") == 0) {
+            options.listing = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.listing = true;
+            options.listingPath = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+            batch = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            options.diagnostics.level = DIAG_DUMP;
+        } else if (strcmp(argv[i], "-q") == 0) {
+            options.diagnostics.level = DIAG_WARNING;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            options.diagnostics.json = true;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty()) {
+        printf("Usage: %s [-S | -o listing] [-j jobs] [-v | -q] [--json] <input file or directory>...\n", argv[0]);
+        return 1;
     }
 
-    fclose(yyin);
-    return 0;
-    
-}
\ No newline at end of file
+    std::vector<std::string> files = collectSourceFiles(inputs);
+    if (!batch && inputs.size() == 1 && files.size() == 1 && files[0] == inputs[0]) {
+        return compileFile(files[0].c_str(), options) == 0 ? 0 : 1;
+    }
+    if (options.listingPath != NULL) {
+        fprintf(stderr, "-o takes a single input file\n");
+        return 1;
+    }
+    return compileBatch(files, jobs, options, compileFile) == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include "source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Read what can't be mapped, such as a pipe
+static bool readSource(SourceBuffer *source, int fd) {
+    size_t capacity = 4096;
+    char *text = (char *)malloc(capacity);
+    size_t length = 0;
+    for (;;) {
+        if (capacity - length <= 2) {
+            capacity *= 2;
+            text = (char *)realloc(text, capacity);
+        }
+        ssize_t n = read(fd, text + length, capacity - length - 2);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(text);
+            return false;
+        }
+        if (n == 0) break;
+        length += n;
+    }
+    text[length] = text[length + 1] = '\0';
+    source->text = text;
+    source->length = length;
+    source->mappedLength = 0;
+    return true;
+}
+
+bool openSource(SourceBuffer *source, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        bool ok = readSource(source, fd);
+        close(fd);
+        return ok;
+    }
+
+    // Reserve whole pages for the file and its NULs, then map the file
+    // over the front.  Past the end of the file the pages are zeros, so
+    // the NULs are already there.
+    size_t length = (size_t)st.st_size;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mappedLength = (length + 2 + page - 1) / page * page;
+    void *base = mmap(NULL, mappedLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (length > 0 &&
+        mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        int error = errno;
+        munmap(base, mappedLength);
+        close(fd);
+        errno = error;
+        return false;
+    }
+    close(fd);
+    source->text = (char *)base;
+    source->length = length;
+    source->mappedLength = mappedLength;
+    return true;
+}
+
+void closeSource(SourceBuffer *source) {
+    if (source->text == NULL) return;
+    if (source->mappedLength > 0) {
+        munmap(source->text, source->mappedLength);
+    } else {
+        free(source->text);
+    }
+    source->text = NULL;
+}
+
+void addTokenSpan(SpanTable *table, TokenSpan span) {
+    if (table->count == table->capacity) {
+        table->capacity = table->capacity ? table->capacity * 2 : 1024;
+        table->spans = (TokenSpan *)realloc(table->spans, table->capacity * sizeof(TokenSpan));
+    }
+    table->spans[table->count++] = span;
+}
+
+void deleteSpanTable(SpanTable *table) {
+    free(table->spans);
+    table->spans = NULL;
+    table->count = table->capacity = 0;
+}
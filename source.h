@@ -0,0 +1,53 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// A source file read into memory for the scanner to work on in place.  A
+// regular file is mapped rather than read; either way the text is followed
+// by the two NUL bytes flex's yy_scan_buffer wants, and may be written to
+// (flex marks the end of each token in the buffer while it looks at it).
+typedef struct SourceBuffer {
+    char *text;
+    size_t length;              // of the file, not counting the NULs
+    size_t mappedLength;        // 0 if text was malloced instead
+} SourceBuffer;
+
+// A piece of the source: where a token starts and how long it is
+typedef struct Span {
+    unsigned int offset;
+    unsigned int length;
+} Span;
+
+// Where a token is: its place in the source, and the line and column
+// (counting from 1) it starts at
+typedef struct TokenSpan {
+    unsigned int offset;
+    unsigned int length;
+    unsigned int line;
+    unsigned int column;
+} TokenSpan;
+
+// The spans of the tokens scanned so far, in order.  A diagnostic works
+// out the text of its line from the source only when it is printed.
+typedef struct SpanTable {
+    TokenSpan *spans;
+    unsigned int count;
+    unsigned int capacity;
+} SpanTable;
+
+// false, with errno set, if the file can't be read
+bool openSource(SourceBuffer *source, const char *path);
+void closeSource(SourceBuffer *source);
+
+void addTokenSpan(SpanTable *table, TokenSpan span);
+void deleteSpanTable(SpanTable *table);
+
+static inline const char *spanText(const SourceBuffer *source, Span span) {
+    return source->text + span.offset;
+}
+
+#endif
@@ -1,62 +1,116 @@
 #include "symbol_table.h"
 
-// Hash function
-unsigned int hash(const char *key) {
-    unsigned int hash = 0;
-    while (*key) {
-        hash = (hash << 5) + *key++;
+#define SYMBOL_TABLE_INITIAL_CAPACITY 64
+#define SYMBOL_TABLE_INITIAL_SCOPES 16
+
+// New symbol table, with the global scope open
+SymbolTable* createSymbolTable() {
+    SymbolTable *table = (SymbolTable *)malloc(sizeof(SymbolTable));
+    table->capacity = SYMBOL_TABLE_INITIAL_CAPACITY;
+    table->count = 0;
+    table->slots = (SymbolSlot *)calloc(table->capacity, sizeof(SymbolSlot));
+    table->last = NULL;
+    table->scopeCapacity = SYMBOL_TABLE_INITIAL_SCOPES;
+    table->scopes = (Scope *)malloc(table->scopeCapacity * sizeof(Scope));
+    table->arena = createArena();
+    table->depth = 0;
+    table->nextSlot = 0;
+    table->scopes[0].lastOutside = NULL;
+    table->scopes[0].firstSlot = 0;
+    table->scopes[0].mark = arenaMark(table->arena);
+    return table;
+}
+
+// The slot of name, or the free slot it would go in
+static SymbolSlot* findSlot(SymbolSlot *slots, unsigned int capacity, const Name *name) {
+    unsigned int index = name->hash & (capacity - 1);
+    while (slots[index].name != NULL && slots[index].name != name) { // names are interned
+        index = (index + 1) & (capacity - 1);
     }
-    return hash % HASH_SIZE;
+    return &slots[index];
 }
 
-// New symbol table
-SymbolTable* createSymbolTable(SymbolTable *parent) {
-    SymbolTable *table = (SymbolTable *)malloc(sizeof(SymbolTable));
-    for (int i = 0; i < HASH_SIZE; i++) {
-        table->table[i] = NULL;
+// Double the table, which keeps it at most half full
+static void growSymbolTable(SymbolTable *table) {
+    unsigned int capacity = table->capacity * 2;
+    SymbolSlot *slots = (SymbolSlot *)calloc(capacity, sizeof(SymbolSlot));
+    for (unsigned int i = 0; i < table->capacity; i++) {
+        if (table->slots[i].name == NULL) continue;
+        *findSlot(slots, capacity, table->slots[i].name) = table->slots[i];
     }
-    table->parent = parent;
-    // printf("Create new symbol table\n"); // for debugging
-    return table;
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
 }
 
-// Insert a symbol into a symbol table
-void insertSymbol(SymbolTable *table, const char *name, const char *type, int isConst) {
-    unsigned int index = hash(name);
-    Symbol *symbol = (Symbol *)malloc(sizeof(Symbol));
-    symbol->name = strdup(name);
-    symbol->type = strdup(type);
-    symbol->isConst = isConst;
-    // Insert into hash table
-    symbol->next = table->table[index];
-    table->table[index] = symbol;
+void enterScope(SymbolTable *table) {
+    if (table->depth + 1 == table->scopeCapacity) {
+        table->scopeCapacity *= 2;
+        table->scopes = (Scope *)realloc(table->scopes, table->scopeCapacity * sizeof(Scope));
+    }
+    Scope *scope = &table->scopes[++table->depth];
+    scope->lastOutside = table->last;
+    scope->firstSlot = table->nextSlot;
+    scope->mark = arenaMark(table->arena);
 }
 
-// Lookup a symbol in the symbol table
-Symbol* lookupSymbol(SymbolTable *table, const char *name) {
-    unsigned int index = hash(name);
-    SymbolTable *current = table;
-    while (current != NULL) {
-        Symbol *symbol = current->table[index];
-        while (symbol != NULL) {
-            if (strcmp(symbol->name, name) == 0) {
-                return symbol; // find
-            }
-            symbol = symbol->next;
-        }
-        current = current->parent; // keep search in parent table
+void exitScope(SymbolTable *table, Diagnostics *diag) {
+    dumpSymbolTable(table, diag);
+    Scope *scope = &table->scopes[table->depth--];
+    // undo the scope's declarations, newest first
+    for (Symbol *symbol = table->last; symbol != scope->lastOutside; symbol = symbol->previous) {
+        findSlot(table->slots, table->capacity, symbol->name)->symbol = symbol->shadowed;
     }
-    return NULL; // not found
+    table->last = scope->lastOutside;
+    if (table->last != NULL) {
+        table->last->next = NULL;
+    }
+    table->nextSlot = scope->firstSlot;
+    arenaRelease(table->arena, scope->mark);
 }
 
-Symbol* lookupSymbolInCurrentTable(SymbolTable *table, const char *name) {
-    unsigned int index = hash(name);
-    Symbol *symbol = table->table[index];
-    while (symbol != NULL) {
-        if (strcmp(symbol->name, name) == 0) {
-            return symbol; // find
+// Insert a symbol into the innermost scope
+Symbol* insertSymbol(SymbolTable *table, const Name *name, const Name *type, int isConst) {
+    SymbolSlot *slot = findSlot(table->slots, table->capacity, name);
+    if (slot->name == NULL) {
+        slot->name = name;
+        if (++table->count * 2 > table->capacity) {
+            growSymbolTable(table);
+            slot = findSlot(table->slots, table->capacity, name);
         }
-        symbol = symbol->next;
+    }
+    Symbol *symbol = (Symbol *)arenaAlloc(table->arena, sizeof(Symbol));
+    symbol->name = name;
+    symbol->type = type;
+    symbol->isConst = isConst;
+    memset(&symbol->value, 0, sizeof(symbol->value)); // not known
+    symbol->depth = table->depth;
+    if (table->depth == 0) {
+        symbol->slot = -1;
+    } else {
+        symbol->slot = table->nextSlot;
+        table->nextSlot += strcmp(type->text, "double") == 0 ? 2 : 1;
+    }
+    symbol->shadowed = slot->symbol;
+    symbol->previous = table->last;
+    symbol->next = NULL;
+    if (table->last != NULL) {
+        table->last->next = symbol;
+    }
+    slot->symbol = symbol;
+    table->last = symbol;
+    return symbol;
+}
+
+// Lookup a symbol in the innermost scope that declares it
+Symbol* lookupSymbol(SymbolTable *table, const Name *name) {
+    return findSlot(table->slots, table->capacity, name)->symbol; // NULL if not found
+}
+
+Symbol* lookupSymbolInCurrentScope(SymbolTable *table, const Name *name) {
+    Symbol *symbol = lookupSymbol(table, name);
+    if (symbol != NULL && symbol->depth == table->depth) {
+        return symbol; // find
     }
     return NULL; // not found
 }
@@ -64,35 +118,24 @@ Symbol* lookupSymbolInCurrentTable(SymbolTable *table, const char *name) {
 // Delete symbol table
 void deleteSymbolTable(SymbolTable *table) {
     if (table == NULL) return;
-    for (int i = 0; i < HASH_SIZE; i++) {
-        Symbol *symbol = table->table[i];
-        while (symbol != NULL) {
-            Symbol *temp = symbol;
-            symbol = symbol->next;
-            free(temp->name);
-            free(temp->type);
-            free(temp);
-        }
-    }
+    free(table->slots);
+    free(table->scopes);
+    deleteArena(table->arena);
     free(table);
 }
 
-// Dump symbol table
-void dumpSymbolTable(SymbolTable *table) {
-    if (table == NULL) return;
-    printf("Symbol Table:\n");
+// Dump the innermost scope, in declaration order
+void dumpSymbolTable(SymbolTable *table, Diagnostics *diag) {
+    if (table == NULL || !wantsDiagnostic(diag, DIAG_DUMP)) return;
+    beginScopeDump(diag);
 
-    for (int i = 0; i < HASH_SIZE; i++) {
-        Symbol *symbol = table->table[i];
-        if (symbol) {
-            while (symbol != NULL) {
-                printf(" Name: %s, Type: %s", symbol->name, symbol->type);
-                if (symbol->isConst) {
-                    printf("(const)");
-                }
-                printf("\n");
-                symbol = symbol->next;
-            }
-        }
+    Symbol *end = table->scopes[table->depth].lastOutside;
+    Symbol *first = NULL;
+    for (Symbol *symbol = table->last; symbol != end; symbol = symbol->previous) {
+        first = symbol;
+    }
+    for (Symbol *symbol = first; symbol != NULL; symbol = symbol->next) {
+        reportSymbol(diag, symbol->name->text, symbol->type->text, symbol->isConst);
     }
-}
\ No newline at end of file
+    endScopeDump(diag);
+}
@@ -6,36 +6,79 @@
 #include <string.h>
 #include <stdbool.h>
 
-#define HASH_SIZE 211
+#include "expr_value.h"
+#include "interner.h"
+#include "arena.h"
+#include "diagnostics.h"
 
 typedef struct Node {
-    char *name;               // variable name
-    char *type;               // variable type
+    const Name *name;         // variable name
+    bool initialized;         // declared with an initializer
+    ExprValue value;          // the initializer's type and value, if any
+    struct Symbol *symbol;    // what the declaration inserted, if anything
     struct Node *next;       // pointer to next
-    void *value;             // initial value if any
 } Node;
 
+// A list built left to right, so it keeps its last node as well
+typedef struct NodeList {
+    Node *head;
+    Node *tail;
+} NodeList;
+
 // Symbol structure
 typedef struct Symbol {
-    char *name;       // id name
-    char *type;       // id type
+    const Name *name; // id name
+    const Name *type; // id type
     int isConst;      // const or not
-    struct Symbol *next; 
+    int depth;        // the scope it was declared in, 0 for globals
+    int slot;         // its JVM local variable, -1 for a global (a static field)
+    ExprValue value;  // a const's value, if known, which is used instead of loading it
+    struct Symbol *shadowed; // the symbol of the same name it hides, if any
+    struct Symbol *previous; // declared before it (the undo log)
+    struct Symbol *next;     // declared after it, for dumping in order
 } Symbol;
 
-// Symbol table structure
+// A name's entry in the table: the innermost symbol of that name in scope,
+// or NULL once every scope that declared it has been left
+typedef struct SymbolSlot {
+    const Name *name;
+    Symbol *symbol;
+} SymbolSlot;
+
+// Where a scope's declarations start in the undo log
+typedef struct Scope {
+    Symbol *lastOutside;        // the newest symbol declared before the scope
+    int firstSlot;              // the scope's locals are numbered from here
+    ArenaMark mark;
+} Scope;
+
+// Symbol table structure.  One open addressing table serves every scope:
+// declaring a symbol pushes it in front of the one it shadows, and leaving
+// a scope walks back through only that scope's declarations, so entering
+// and leaving cost nothing for the symbols of the enclosing scopes.
+// Symbols below the global scope are numbered into the JVM local variable
+// slots of the method being compiled, in declaration order; a double takes
+// two.  A scope's slots are free for reuse once it is left.
 typedef struct SymbolTable {
-    Symbol *table[HASH_SIZE];      // hash table
-    struct SymbolTable *parent;    // point to parent table
+    SymbolSlot *slots;          // capacity is a power of two, name NULL if free
+    unsigned int capacity;
+    unsigned int count;
+    Symbol *last;               // the newest symbol declared in any open scope
+    Scope *scopes;              // scopes[0] is the global scope
+    int depth;                  // index of the innermost open scope
+    int scopeCapacity;
+    int nextSlot;               // the first slot no open scope uses
+    Arena *arena;               // symbols, released with their scope
 } SymbolTable;
 
-SymbolTable* createSymbolTable(SymbolTable *parent);
-void insertSymbol(SymbolTable *table, const char *name, const char *type, int isConst);
-Symbol* lookupSymbol(SymbolTable *table, const char *name);
-Symbol* lookupSymbolInCurrentTable(SymbolTable *table, const char *name);
+SymbolTable* createSymbolTable();
+void enterScope(SymbolTable *table);
+// dumps the innermost scope's symbols, if diag wants them, and drops them
+void exitScope(SymbolTable *table, Diagnostics *diag);
+Symbol* insertSymbol(SymbolTable *table, const Name *name, const Name *type, int isConst);
+Symbol* lookupSymbol(SymbolTable *table, const Name *name);
+Symbol* lookupSymbolInCurrentScope(SymbolTable *table, const Name *name);
 void deleteSymbolTable(SymbolTable *table);
-void dumpSymbolTable(SymbolTable *table);
-
-unsigned int hash(const char *key);
+void dumpSymbolTable(SymbolTable *table, Diagnostics *diag);
 
 #endif
\ No newline at end of file
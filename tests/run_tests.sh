@@ -0,0 +1,33 @@
+#!/bin/sh
+# Compiles every tests/*.sd with the parser given (./parser by default).
+# What it reports on stderr, at -q, must match NAME.err if there is one,
+# and what the class prints must match NAME.out, when java is on the PATH.
+# Each test is compiled in a directory of its own, as the class is named
+# after the file.
+
+parser=$(cd "$(dirname "${1:-./parser}")" && pwd)/$(basename "${1:-./parser}")
+tests=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failed=0
+
+for source in "$tests"/*.sd; do
+    name=$(basename "$source" .sd)
+    mkdir "$work/$name"
+    cp "$source" "$work/$name/"
+    (cd "$work/$name" && "$parser" -q "$name.sd" >/dev/null 2>stderr)
+    if [ -f "$tests/$name.err" ] && ! diff -u "$tests/$name.err" "$work/$name/stderr"; then
+        echo "FAIL $name: diagnostics"
+        failed=1
+        continue
+    fi
+    if [ -f "$tests/$name.out" ] && command -v java >/dev/null 2>&1; then
+        if ! (cd "$work/$name" && java -cp . "$name") | diff -u "$tests/$name.out" -; then
+            echo "FAIL $name: output"
+            failed=1
+            continue
+        fi
+    fi
+    echo "ok   $name"
+done
+exit $failed